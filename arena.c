@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <arena.h>
+
+//the first chunk is small so that small arenas stay small, later chunks double
+//up to the size of a huge page
+#define ARENA_CHUNK_MIN (64 * 1024)
+#define ARENA_CHUNK_MAX (2 * 1024 * 1024)
+
+//every chunk starts with this header, the objects follow it
+struct arena_chunk{
+    struct arena_chunk* next;
+    size_t size;
+};
+
+struct arena{
+    //the chunks, most recently mapped first; objects are bumped out of the first
+    struct arena_chunk* chunks;
+    char* bump;
+    char* end;
+
+    //the size of the next chunk to map
+    size_t next_size;
+
+    size_t used;
+    size_t mapped;
+    int flags;
+};
+
+//maps a chunk of `size` bytes, using huge pages for full-sized chunks if asked to
+static struct arena_chunk* chunk_map(struct arena* a, size_t size){
+    void* mem = MAP_FAILED;
+
+    if((a->flags & ARENA_HUGEPAGES) && size == ARENA_CHUNK_MAX){
+#ifdef MAP_HUGETLB
+        //reserved huge pages first, this fails if the system has none set aside
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if(mem == MAP_FAILED){
+            mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+            //otherwise let transparent huge pages back it
+            if(mem != MAP_FAILED){
+                madvise(mem, size, MADV_HUGEPAGE);
+            }
+#endif
+        }
+    } else{
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if(mem == MAP_FAILED){
+        return NULL;
+    }
+
+    struct arena_chunk* chunk = mem;
+    chunk->size = size;
+    a->mapped += size;
+
+    return chunk;
+}
+
+struct arena *arena_create(int flags){
+    struct arena* a = calloc(1, sizeof(struct arena));
+
+    if(a == NULL){
+        return NULL;
+    }
+    a->next_size = ARENA_CHUNK_MIN;
+    a->flags = flags;
+
+    return a;
+}
+
+void arena_destroy(struct arena *a){
+    if(a == NULL){
+        return;
+    }
+
+    //one munmap per chunk releases every object at once
+    struct arena_chunk* chunk = a->chunks;
+    while(chunk != NULL){
+        struct arena_chunk* next = chunk->next;
+        munmap(chunk, chunk->size);
+        chunk = next;
+    }
+
+    free(a);
+}
+
+void *arena_alloc(struct arena *a, size_t size, size_t align){
+    uintptr_t p = ((uintptr_t)a->bump + align - 1) & ~(uintptr_t)(align - 1);
+
+    //map a new chunk if the current one cannot fit the object
+    if(a->bump == NULL || p + size > (uintptr_t)a->end){
+        size_t need = sizeof(struct arena_chunk) + size + align;
+        size_t chunk_size = a->next_size;
+
+        //objects too large for a normal chunk get a chunk of their own
+        if(need > chunk_size){
+            chunk_size = (need + ARENA_CHUNK_MIN - 1) & ~(size_t)(ARENA_CHUNK_MIN - 1);
+        } else if(a->next_size < ARENA_CHUNK_MAX){
+            a->next_size *= 2;
+        }
+
+        struct arena_chunk* chunk = chunk_map(a, chunk_size);
+        if(chunk == NULL){
+            return NULL;
+        }
+        chunk->next = a->chunks;
+        a->chunks = chunk;
+        a->bump = (char*)(chunk + 1);
+        a->end = (char*)chunk + chunk_size;
+        p = ((uintptr_t)a->bump + align - 1) & ~(uintptr_t)(align - 1);
+    }
+
+    //fresh anonymous mappings are already zeroed
+    a->bump = (char*)(p + size);
+    a->used += size;
+
+    return (void*)p;
+}
+
+size_t arena_used(struct arena *a){
+    return a->used;
+}
+
+size_t arena_mapped(struct arena *a){
+    return a->mapped;
+}
+
+void slab_init(struct slab *s, struct arena *a, size_t size){
+    s->arena = a;
+    //every object has to be able to hold the free list link
+    s->size = size < sizeof(void*) ? sizeof(void*) : size;
+    s->free = NULL;
+}
+
+void *slab_alloc(struct slab *s){
+    void* obj = s->free;
+
+    //reuse a freed object if there is one
+    if(obj != NULL){
+        s->free = *(void**)obj;
+        memset(obj, 0, s->size);
+        return obj;
+    }
+
+    return arena_alloc(s->arena, s->size, sizeof(void*));
+}
+
+void slab_free(struct slab *s, void *obj){
+    if(obj == NULL){
+        return;
+    }
+    *(void**)obj = s->free;
+    s->free = obj;
+}
@@ -0,0 +1,76 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/***
+ * An arena hands out memory from a few large `mmap`ed chunks, so that
+ * a data-structure made of many small objects (like the nodes of the
+ * ptrie) does not pay for a `malloc` per object, and can release all
+ * of them at once with a handful of `munmap`s.
+ *
+ * The arena itself only bump-allocates: memory is never given back
+ * until `arena_destroy`. Objects of a fixed size that are freed and
+ * reallocated often can be recycled through a `struct slab` on top of
+ * the arena.
+ */
+struct arena;
+
+/* Back the arena's largest chunks with huge pages when possible */
+#define ARENA_HUGEPAGES 1
+
+/**
+ * `arena_create` allocates a new, empty arena.
+ *
+ * - `@flags` - `0`, or `ARENA_HUGEPAGES` to ask the kernel to back
+ *     large chunks with huge pages. This is a hint: if no huge pages
+ *     are available, normal pages are used.
+ * - `@return` - The arena, or `NULL` if it could not be allocated.
+ */
+struct arena *arena_create(int flags);
+
+/**
+ * `arena_destroy` unmaps every chunk of the arena, freeing every
+ * object allocated from it, and the arena itself.
+ */
+void arena_destroy(struct arena *a);
+
+/**
+ * `arena_alloc` bump-allocates `size` bytes aligned to `align` (a
+ * power of two) from the arena. The memory is zeroed.
+ *
+ * - `@return` - The memory, owned by the arena, or `NULL` if a new
+ *     chunk could not be mapped.
+ */
+void *arena_alloc(struct arena *a, size_t size, size_t align);
+
+/**
+ * `arena_used` returns how many bytes were handed out by the arena,
+ * and `arena_mapped` how many bytes it has mapped in total.
+ */
+size_t arena_used(struct arena *a);
+size_t arena_mapped(struct arena *a);
+
+/**
+ * A slab allocates objects of one fixed size from an arena, and keeps
+ * freed objects on a free list to hand them out again.
+ */
+struct slab {
+    struct arena *arena;
+    size_t size;
+    void *free;
+};
+
+/**
+ * `slab_init` sets up `s` to allocate `size`-byte objects from `a`.
+ */
+void slab_init(struct slab *s, struct arena *a, size_t size);
+
+/**
+ * `slab_alloc` returns a zeroed object, or `NULL` if the arena could
+ * not grow. `slab_free` puts an object back on the free list.
+ */
+void *slab_alloc(struct slab *s);
+void slab_free(struct slab *s, void *obj);
+
+#endif /* ARENA_H */
@@ -0,0 +1,126 @@
+#include <stddef.h>
+#include <argmax.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ARGMAX_X86
+#endif
+
+//the index of the first value equal to `max` from `i` on, which has to exist
+static size_t first_equal(const double* v, size_t i, double max){
+    while(v[i] != max){
+        i++;
+    }
+    return i;
+}
+
+static size_t argmax_scalar(const double* v, size_t n){
+    size_t best = 0;
+
+    for(size_t i = 1; i < n; i++){
+        if(v[i] > v[best]){
+            best = i;
+        }
+    }
+    return best;
+}
+
+#ifdef ARGMAX_X86
+//both kernels take two passes: the maximum across all lanes first, then the
+//first position holding it. Keeping a lane-wise index instead would need a
+//tie-break on the lowest index in every lane.
+
+__attribute__((target("sse2")))
+static size_t argmax_sse2(const double* v, size_t n){
+    size_t i = 0;
+    double max = v[0];
+
+    if(n >= 2){
+        __m128d m = _mm_loadu_pd(v);
+
+        for(i = 2; i + 2 <= n; i += 2){
+            m = _mm_max_pd(m, _mm_loadu_pd(v + i));
+        }
+        m = _mm_max_pd(m, _mm_unpackhi_pd(m, m));
+        max = _mm_cvtsd_f64(m);
+    }
+    for(; i < n; i++){
+        max = v[i] > max ? v[i] : max;
+    }
+
+    //find where it is, two values at a time
+    __m128d want = _mm_set1_pd(max);
+    for(i = 0; i + 2 <= n; i += 2){
+        int mask = _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(v + i), want));
+        if(mask != 0){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return first_equal(v, i, max);
+}
+
+__attribute__((target("avx2")))
+static size_t argmax_avx2(const double* v, size_t n){
+    size_t i = 0;
+    double max = v[0];
+
+    if(n >= 4){
+        __m256d m = _mm256_loadu_pd(v);
+
+        for(i = 4; i + 4 <= n; i += 4){
+            m = _mm256_max_pd(m, _mm256_loadu_pd(v + i));
+        }
+        __m128d h = _mm_max_pd(_mm256_castpd256_pd128(m), _mm256_extractf128_pd(m, 1));
+        h = _mm_max_pd(h, _mm_unpackhi_pd(h, h));
+        max = _mm_cvtsd_f64(h);
+    }
+    for(; i < n; i++){
+        max = v[i] > max ? v[i] : max;
+    }
+
+    //find where it is, four values at a time
+    __m256d want = _mm256_set1_pd(max);
+    for(i = 0; i + 4 <= n; i += 4){
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(v + i), want, _CMP_EQ_OQ));
+        if(mask != 0){
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return first_equal(v, i, max);
+}
+#endif
+
+//the kernel for this CPU, picked before main runs so that threads never race on it
+static argmax_fn argmax_kernel = argmax_scalar;
+
+__attribute__((constructor))
+static void argmax_select(void){
+#ifdef ARGMAX_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        argmax_kernel = argmax_avx2;
+    } else if(__builtin_cpu_supports("sse2")){
+        argmax_kernel = argmax_sse2;
+    }
+#endif
+}
+
+size_t argmax(const double *v, size_t n){
+    return argmax_kernel(v, n);
+}
+
+argmax_fn argmax_kernel_at(size_t i){
+    //the plain loop, then the kernels this CPU can run from the widest down
+    argmax_fn kernels[3] = { argmax_scalar };
+    size_t n = 1;
+
+#ifdef ARGMAX_X86
+    if(__builtin_cpu_supports("avx2")){
+        kernels[n++] = argmax_avx2;
+    }
+    if(__builtin_cpu_supports("sse2")){
+        kernels[n++] = argmax_sse2;
+    }
+#endif
+    return i < n ? kernels[i] : NULL;
+}
@@ -0,0 +1,35 @@
+#ifndef ARGMAX_H
+#define ARGMAX_H
+
+#include <stddef.h>
+
+/***
+ * Finds the largest of an array of doubles, for picking the best of
+ * many candidates at once. The search is vectorized with AVX2 or SSE2
+ * when the CPU has them, which is decided once at startup, and falls
+ * back to a plain loop otherwise.
+ */
+
+/**
+ * `argmax` returns the index of the largest value in `v`, the lowest
+ * such index if several are equal.
+ *
+ * - `@v` - The values, none of which may be NaN.
+ * - `@n` - The number of values, at least `1`.
+ */
+size_t argmax(const double *v, size_t n);
+
+typedef size_t (*argmax_fn)(const double *v, size_t n);
+
+/**
+ * `argmax_kernel_at` returns one of the kernels that `argmax` can
+ * pick from, so that each can be checked against the others. They
+ * all behave as `argmax`.
+ *
+ * - `@i` - Which kernel: `0` is the plain loop, and the vectorized
+ *     ones this CPU can run follow.
+ * - `@return` - The kernel, or `NULL` if there are fewer than `i + 1`.
+ */
+argmax_fn argmax_kernel_at(size_t i);
+
+#endif /* ARGMAX_H */
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ptrie.h>
+#include <argtrie.h>
+
+//the arguments learned for one program, by position. Position 0 is the program
+//itself, so it is never used.
+struct argtrie_program{
+    char* name;
+    struct ptrie* pos[ARGTRIE_POSITIONS + 1];
+
+    //how many commands ran it, and when the last one did, to pick whom to evict
+    size_t uses;
+    size_t last;
+};
+
+struct argtrie{
+    //the programs, sorted by name
+    struct argtrie_program** progs;
+    size_t n;
+    size_t cap;
+
+    //the budget of each position of each program, 0 for none
+    size_t budget;
+
+    //the most programs kept, 0 for no limit, and the number of commands learned
+    size_t max_programs;
+    size_t clock;
+};
+
+struct argtrie *argtrie_allocate(void){
+    return calloc(1, sizeof(struct argtrie));
+}
+
+static void free_program(struct argtrie_program* prog){
+    for(size_t i = 1; i <= ARGTRIE_POSITIONS; i++){
+        if(prog->pos[i] != NULL){
+            ptrie_free(prog->pos[i]);
+        }
+    }
+    free(prog->name);
+    free(prog);
+}
+
+void argtrie_free(struct argtrie *at){
+    if(at == NULL){
+        return;
+    }
+    for(size_t i = 0; i < at->n; i++){
+        free_program(at->progs[i]);
+    }
+    free(at->progs);
+    free(at);
+}
+
+//the index of `program` in `progs` if it is there, else the index where it
+//would be inserted, with `found` set accordingly
+static size_t find_program(struct argtrie* at, const char* program, int* found){
+    size_t lo = 0, hi = at->n;
+
+    while(lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(at->progs[mid]->name, program);
+
+        if(cmp == 0){
+            *found = 1;
+            return mid;
+        }
+        if(cmp < 0){
+            lo = mid + 1;
+        } else{
+            hi = mid;
+        }
+    }
+    *found = 0;
+    return lo;
+}
+
+//evicts the least used program, the one run least recently among those used as little
+static void evict_program(struct argtrie* at){
+    size_t victim = 0;
+
+    for(size_t i = 1; i < at->n; i++){
+        struct argtrie_program* prog = at->progs[i];
+        struct argtrie_program* min = at->progs[victim];
+
+        if(prog->uses < min->uses || (prog->uses == min->uses && prog->last < min->last)){
+            victim = i;
+        }
+    }
+    free_program(at->progs[victim]);
+    memmove(&at->progs[victim], &at->progs[victim + 1], (at->n - victim - 1) * sizeof(struct argtrie_program*));
+    at->n--;
+}
+
+//the entry of `program`, inserted if it was not there yet
+static struct argtrie_program* get_program(struct argtrie* at, const char* program){
+    int found;
+    size_t i = find_program(at, program, &found);
+
+    if(found){
+        return at->progs[i];
+    }
+
+    //make room for it, and find where it goes among those left
+    if(at->max_programs != 0 && at->n >= at->max_programs){
+        while(at->n >= at->max_programs){
+            evict_program(at);
+        }
+        i = find_program(at, program, &found);
+    }
+    if(at->n == at->cap){
+        size_t cap = at->cap == 0 ? 16 : at->cap * 2;
+        struct argtrie_program** progs = realloc(at->progs, cap * sizeof(struct argtrie_program*));
+
+        if(progs == NULL){
+            return NULL;
+        }
+        at->progs = progs;
+        at->cap = cap;
+    }
+
+    struct argtrie_program* prog = calloc(1, sizeof(struct argtrie_program));
+    if(prog == NULL){
+        return NULL;
+    }
+    prog->name = strdup(program);
+    if(prog->name == NULL){
+        free(prog);
+        return NULL;
+    }
+    memmove(&at->progs[i + 1], &at->progs[i], (at->n - i) * sizeof(struct argtrie_program*));
+    at->progs[i] = prog;
+    at->n++;
+
+    return prog;
+}
+
+int argtrie_add(struct argtrie *at, char **args){
+    struct argtrie_program* prog;
+    int ret = 0;
+
+    if(args == NULL || args[0] == NULL || args[1] == NULL){
+        return 0;
+    }
+    prog = get_program(at, args[0]);
+    if(prog == NULL){
+        return -1;
+    }
+    prog->uses++;
+    prog->last = ++at->clock;
+    for(size_t i = 1; i <= ARGTRIE_POSITIONS && args[i] != NULL; i++){
+        if(prog->pos[i] == NULL){
+            prog->pos[i] = ptrie_allocate();
+            if(prog->pos[i] == NULL){
+                return -1;
+            }
+            ptrie_set_budget(prog->pos[i], at->budget);
+        }
+        //an argument the ptrie cannot hold is skipped, the ones after it are still learned
+        if(ptrie_add(prog->pos[i], args[i]) != 0){
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+size_t argtrie_topk(struct argtrie *at, const char *program, size_t pos, const char *prefix, size_t k,
+                    const char **out){
+    int found;
+    size_t i = find_program(at, program, &found);
+
+    if(!found || pos == 0 || pos > ARGTRIE_POSITIONS || at->progs[i]->pos[pos] == NULL){
+        return 0;
+    }
+    return ptrie_topk(at->progs[i]->pos[pos], prefix, k, out);
+}
+
+//the memory used by `prog`, its own and what its ptries reserved
+static size_t program_bytes(struct argtrie_program* prog){
+    size_t bytes = sizeof(struct argtrie_program) + strlen(prog->name) + 1;
+
+    for(size_t i = 1; i <= ARGTRIE_POSITIONS; i++){
+        if(prog->pos[i] != NULL){
+            struct ptrie_stats stats;
+
+            ptrie_stats(prog->pos[i], &stats);
+            bytes += stats.reserved;
+        }
+    }
+    return bytes;
+}
+
+size_t argtrie_bytes(struct argtrie *at, const char *program){
+    size_t bytes = 0;
+
+    if(program != NULL){
+        int found;
+        size_t i = find_program(at, program, &found);
+
+        return found ? program_bytes(at->progs[i]) : 0;
+    }
+    for(size_t i = 0; i < at->n; i++){
+        bytes += program_bytes(at->progs[i]);
+    }
+    return bytes + sizeof(struct argtrie) + at->cap * sizeof(struct argtrie_program*);
+}
+
+void argtrie_set_budget(struct argtrie *at, size_t bytes){
+    at->budget = bytes;
+    for(size_t i = 0; i < at->n; i++){
+        for(size_t j = 1; j <= ARGTRIE_POSITIONS; j++){
+            if(at->progs[i]->pos[j] != NULL){
+                ptrie_set_budget(at->progs[i]->pos[j], bytes);
+            }
+        }
+    }
+}
+
+void argtrie_set_max_programs(struct argtrie *at, size_t n){
+    at->max_programs = n;
+    while(n != 0 && at->n > n){
+        evict_program(at);
+    }
+}
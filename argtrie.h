@@ -0,0 +1,90 @@
+#ifndef ARGTRIE_H
+#define ARGTRIE_H
+
+#include <stddef.h>
+
+/***
+ * The argument trie learns the arguments each program was run with,
+ * so that the word being typed can be completed from what followed the
+ * same program before (`git ch` to `git checkout`), rather than from
+ * whole past lines. Every program has a prefix trie of the arguments
+ * seen at each position, which ranks them the way the ptrie does.
+ */
+struct argtrie;
+
+/* Arguments past this position are not learned */
+#define ARGTRIE_POSITIONS 8
+
+/**
+ * `argtrie_allocate` allocates a new, empty argument trie, `NULL` if it
+ * could not be, and `argtrie_free` frees it.
+ */
+struct argtrie *argtrie_allocate(void);
+void argtrie_free(struct argtrie *at);
+
+/**
+ * `argtrie_add` learns the arguments of one command.
+ *
+ * - `@at` - The argument trie.
+ * - `@args` - The `NULL`-terminated arguments of the command, the
+ *     program first, as returned by `msh_command_args`. They are
+ *     *borrowed* from the caller.
+ * - `@return` - `0` on success, `-1` on `malloc` failure or if an
+ *     argument could not be added to a ptrie (see `ptrie_add`). Such
+ *     an argument is skipped, and those after it are still learned.
+ */
+int argtrie_add(struct argtrie *at, char **args);
+
+/**
+ * `argtrie_topk` finds the `k` arguments most often given to `program`
+ * at position `pos` that start with `prefix`, the same way
+ * `ptrie_topk` does.
+ *
+ * Arguments:
+ *
+ * - `@at` - The argument trie.
+ * - `@program` - The program, as in `msh_command_program`.
+ * - `@pos` - The position of the argument, `1` for the first one after
+ *     the program.
+ * - `@prefix` - What was typed of the argument so far.
+ * - `@k` - The maximum number of arguments to return.
+ * - `@out` - An array of at least `k` entries that is filled with the
+ *     arguments, most frequent first. They are *borrowed* from the
+ *     argument trie, and valid until the next `argtrie_add`,
+ *     `argtrie_set_max_programs`, or `argtrie_free`.
+ * - `@return` - The number of arguments placed in `out`.
+ */
+size_t argtrie_topk(struct argtrie *at, const char *program, size_t pos, const char *prefix, size_t k,
+                    const char **out);
+
+/**
+ * `argtrie_bytes` reports the memory reserved for the arguments of
+ * `program`, or for those of every program if `program` is `NULL`.
+ * This counts what the ptries reserved (see `ptrie_stats`), not just
+ * what their strings use.
+ */
+size_t argtrie_bytes(struct argtrie *at, const char *program);
+
+/**
+ * `argtrie_set_budget` caps the memory used for the arguments of each
+ * program at each position, evicting the least recently given ones
+ * like `ptrie_set_budget` does. A program can then use up to
+ * `ARGTRIE_POSITIONS` times `bytes`.
+ *
+ * - `@at` - The argument trie.
+ * - `@bytes` - The budget in bytes, or `0` for no limit (the default).
+ */
+void argtrie_set_budget(struct argtrie *at, size_t bytes);
+
+/**
+ * `argtrie_set_max_programs` caps the number of programs whose
+ * arguments are learned. Learning a new program past the cap evicts
+ * the one run the fewest times, the least recently run of those if
+ * several were, along with everything learned for it.
+ *
+ * - `@at` - The argument trie.
+ * - `@n` - The most programs kept, or `0` for no limit (the default).
+ */
+void argtrie_set_max_programs(struct argtrie *at, size_t n);
+
+#endif /* ARGTRIE_H */
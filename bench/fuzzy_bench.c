@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <fuzzy.h>
+
+/***
+ * Microbenchmark for the fuzzy matcher. It adds 100k generated command
+ * lines, like a long shell history, and times `fuzzy_match` for a few
+ * patterns of different selectivity.
+ *
+ * Usage: `fuzzy_bench.bench`
+ */
+
+#define BENCH_LINES   100000
+#define BENCH_LINELEN 256
+#define BENCH_K       16
+#define BENCH_RUNS    20
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//a command line of a few words from a small vocabulary, with a fixed seed so
+//that runs are comparable
+static void generate_line(char* line){
+    static const char* cmds[] = { "git", "make", "ls", "cd", "grep", "ssh", "docker", "vim", "cat", "find" };
+    static const char* args[] = { "checkout", "status", "-la", "--color=auto", "src/", "build", "commit -m",
+                                  "/etc/hosts", "run -it", "origin/main", "*.c", "-rn", "TODO", "bench", "user@host" };
+    int nargs = 1 + rand() % 5;
+
+    strcpy(line, cmds[rand() % (sizeof(cmds) / sizeof(cmds[0]))]);
+    for(int i = 0; i < nargs; i++){
+        strcat(line, " ");
+        strcat(line, args[rand() % (sizeof(args) / sizeof(args[0]))]);
+    }
+
+    //and something unique, like a file name or a message
+    char tail[32];
+    snprintf(tail, sizeof(tail), " %x", rand());
+    strcat(line, tail);
+}
+
+int main(void){
+    static const char* patterns[] = { "gco", "mkbld", "grep TODO", "dckrrun", "zzzq" };
+    static char lines[BENCH_LINES][BENCH_LINELEN];
+    const char* out[BENCH_K];
+    struct fuzzy* fz = fuzzy_allocate();
+    double start;
+
+    srand(42);
+    for(int i = 0; i < BENCH_LINES; i++){
+        generate_line(lines[i]);
+    }
+    start = now();
+    for(int i = 0; i < BENCH_LINES; i++){
+        fuzzy_add(fz, lines[i]);
+    }
+    printf("fuzzy_add:   %8.1f ns/op (%d lines)\n", (now() - start) * 1e9 / BENCH_LINES, BENCH_LINES);
+
+    for(size_t p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++){
+        size_t n = 0;
+
+        start = now();
+        for(int r = 0; r < BENCH_RUNS; r++){
+            n = fuzzy_match(fz, patterns[p], BENCH_K, out);
+        }
+        printf("fuzzy_match: %8.3f ms/op (\"%s\", %zu matches, best \"%s\")\n",
+               (now() - start) * 1e3 / BENCH_RUNS, patterns[p], n, n > 0 ? out[0] : "");
+    }
+    fuzzy_free(fz);
+
+    return 0;
+}
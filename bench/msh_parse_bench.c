@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <msh.h>
+#include <msh_parse.h>
+
+/***
+ * Microbenchmark for `msh_sequence_parse`. It parses a few typical
+ * lines, from a lone program to a sequence of pipelines with
+ * redirections, into a fresh sequence each time. The sequences are
+ * allocated and freed in batches, timed apart from the parse, and the
+ * whole of it is reported too. Then it parses them into a single
+ * sequence that is reset after each line, the way the shell does, so
+ * that the pooled memory is reused. The allocations are counted for
+ * all of them. The last lines are generated past the limits msh used
+ * to have: an `xargs`-style list of files, a long pipeline, and a long
+ * sequence. Those are parsed fewer times, as they take longer.
+ *
+ * Usage: `msh_parse_bench.bench`
+ */
+
+#define BENCH_RUNS  200000
+#define BENCH_BATCH 16
+#define BENCH_LARGE 1000
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//how many times to parse `line`, fewer for longer lines, in whole batches
+static int runs_for(const char* line){
+    size_t len = strlen(line);
+    int runs = len <= 64 ? BENCH_RUNS : (int)(BENCH_RUNS * 64 / len);
+
+    return runs < BENCH_BATCH ? BENCH_BATCH : runs - runs % BENCH_BATCH;
+}
+
+int main(void){
+    static char files[BENCH_LARGE * 16], pipeline[BENCH_LARGE * 8], sequence[BENCH_LARGE * 8];
+    static char* lines[] = {
+        "ls",
+        "git checkout -b feature/parser origin/main",
+        "cat access.log | grep GET | sort | uniq -c | sort -rn | head 1> top.txt",
+        "make -j8 2>> build.log ; ./msh < input.txt ; sleep 10 &",
+        files,
+        pipeline,
+        sequence,
+    };
+
+    //BENCH_LARGE files, BENCH_LARGE / 10 commands, and BENCH_LARGE / 10 pipelines
+    strcpy(files, "rm -f");
+    for(int i = 0; i < BENCH_LARGE; i++){
+        sprintf(files + strlen(files), " src/f%04d.o", i);
+    }
+    strcpy(pipeline, "cat data.csv");
+    for(int i = 0; i < BENCH_LARGE / 10; i++){
+        strcat(pipeline, i % 2 == 0 ? " | cut -d, -f2" : " | sort -u");
+    }
+    strcpy(sequence, "mkdir -p out");
+    for(int i = 0; i < BENCH_LARGE / 10; i++){
+        sprintf(sequence + strlen(sequence), " ; cp in/%d out/", i);
+    }
+
+    static struct msh_sequence* seqs[BENCH_BATCH];
+
+    for(size_t l = 0; l < sizeof(lines) / sizeof(lines[0]); l++){
+        double elapsed = 0, total = 0;
+        size_t allocs = 0, parse_allocs = 0;
+        int runs = runs_for(lines[l]);
+
+        for(int r = 0; r < runs; r += BENCH_BATCH){
+            size_t before = msh_parse_allocations();
+            double first = now(), start;
+
+            for(int i = 0; i < BENCH_BATCH; i++){
+                seqs[i] = msh_sequence_alloc();
+                if(seqs[i] == NULL){
+                    fprintf(stderr, "Could not allocate a sequence\n");
+                    return EXIT_FAILURE;
+                }
+            }
+            allocs += msh_parse_allocations() - before;
+            before = msh_parse_allocations();
+            start = now();
+            for(int i = 0; i < BENCH_BATCH; i++){
+                if(msh_sequence_parse(lines[l], seqs[i]) != 0){
+                    fprintf(stderr, "Could not parse \"%s\"\n", lines[l]);
+                    return EXIT_FAILURE;
+                }
+            }
+            elapsed += now() - start;
+            parse_allocs += msh_parse_allocations() - before;
+            for(int i = 0; i < BENCH_BATCH; i++){
+                msh_sequence_free(seqs[i]);
+            }
+            total += now() - first;
+        }
+        printf("msh_sequence_parse: %8.1f ns/op, %8.1f ns/line with the sequence, %zu + %zu allocations (\"%.40s%s\")\n",
+               elapsed * 1e9 / runs, total * 1e9 / runs, allocs / runs, parse_allocs / runs, lines[l],
+               strlen(lines[l]) > 40 ? "..." : "");
+    }
+
+    struct msh_sequence* seq = msh_sequence_alloc();
+    if(seq == NULL){
+        fprintf(stderr, "Could not allocate a sequence\n");
+        return EXIT_FAILURE;
+    }
+    for(size_t l = 0; l < sizeof(lines) / sizeof(lines[0]); l++){
+        struct msh_pipeline* p;
+        size_t before = msh_parse_allocations();
+        int runs = runs_for(lines[l]);
+        double start = now();
+
+        for(int r = 0; r < runs; r++){
+            if(msh_sequence_parse(lines[l], seq) != 0){
+                fprintf(stderr, "Could not parse \"%s\"\n", lines[l]);
+                return EXIT_FAILURE;
+            }
+            while((p = msh_sequence_pipeline(seq)) != NULL){
+                msh_pipeline_free(p);
+            }
+            msh_sequence_reset(seq);
+        }
+        printf("msh_sequence_reset: %8.1f ns/line reusing the sequence, %zu allocations in %d lines (\"%.40s%s\")\n",
+               (now() - start) * 1e9 / runs, msh_parse_allocations() - before, runs, lines[l],
+               strlen(lines[l]) > 40 ? "..." : "");
+    }
+    msh_sequence_free(seq);
+
+    return 0;
+}
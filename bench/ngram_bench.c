@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <ngram.h>
+#include <ptrie.h>
+
+/***
+ * Microbenchmark for the n-gram index. It adds 65536 generated command
+ * lines, as many as the history keeps, and times `ngram_search` for a
+ * few substrings of different selectivity, the way each keystroke of a
+ * reverse-i-search would. The lines are ranked by their frecency in a
+ * ptrie of them, like the shell's history.
+ *
+ * Usage: `ngram_bench.bench`
+ */
+
+#define BENCH_LINES   65536
+#define BENCH_LINELEN 256
+#define BENCH_K       16
+#define BENCH_RUNS    100
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//a command line of a few words from a small vocabulary, with a fixed seed so
+//that runs are comparable. One in four lines is a repeat of an earlier one.
+static void generate_line(char* line, char (*lines)[BENCH_LINELEN], int i){
+    static const char* cmds[] = { "git", "make", "ls", "cd", "grep", "ssh", "docker", "vim", "cat", "find" };
+    static const char* args[] = { "checkout", "status", "-la", "--color=auto", "src/", "build", "commit -m",
+                                  "/etc/hosts", "run -it", "origin/main", "*.c", "-rn", "TODO", "bench", "user@host" };
+    int nargs = 1 + rand() % 5;
+
+    if(i > 0 && rand() % 4 == 0){
+        strcpy(line, lines[rand() % i]);
+        return;
+    }
+    strcpy(line, cmds[rand() % (sizeof(cmds) / sizeof(cmds[0]))]);
+    for(int j = 0; j < nargs; j++){
+        strcat(line, " ");
+        strcat(line, args[rand() % (sizeof(args) / sizeof(args[0]))]);
+    }
+
+    //and something unique, like a file name or a message
+    char tail[32];
+    snprintf(tail, sizeof(tail), " %x", rand());
+    strcat(line, tail);
+}
+
+int main(void){
+    static const char* substrs[] = { "gi", "checkout", "run -it src/", "origin/main TODO", "1a2b", "zzzq" };
+    static char lines[BENCH_LINES][BENCH_LINELEN];
+    const char* out[BENCH_K];
+    struct ngram* ng = ngram_allocate();
+    struct ptrie* past = ptrie_allocate();
+    double start;
+
+    srand(42);
+    for(int i = 0; i < BENCH_LINES; i++){
+        generate_line(lines[i], lines, i);
+    }
+    ptrie_set_halflife(past, 24 * 60 * 60);
+    for(int i = 0; i < BENCH_LINES; i++){
+        ptrie_add(past, lines[i]);
+    }
+    start = now();
+    for(int i = 0; i < BENCH_LINES; i++){
+        ngram_add(ng, lines[i], ptrie_rank(past, lines[i]));
+    }
+    printf("ngram_add:    %8.1f ns/op (%d lines)\n", (now() - start) * 1e9 / BENCH_LINES, BENCH_LINES);
+
+    for(size_t p = 0; p < sizeof(substrs) / sizeof(substrs[0]); p++){
+        size_t n = 0;
+
+        start = now();
+        for(int r = 0; r < BENCH_RUNS; r++){
+            n = ngram_search(ng, substrs[p], BENCH_K, out);
+        }
+        printf("ngram_search: %8.1f us/op (\"%s\", %zu matches, best \"%s\")\n",
+               (now() - start) * 1e6 / BENCH_RUNS, substrs[p], n, n > 0 ? out[0] : "");
+    }
+
+    //and removing half of the lines, as the history evicts them
+    start = now();
+    for(int i = 0; i < BENCH_LINES; i += 2){
+        ngram_remove(ng, lines[i]);
+    }
+    printf("ngram_remove: %8.1f ns/op (%d lines)\n", (now() - start) * 1e9 / (BENCH_LINES / 2), BENCH_LINES / 2);
+    ngram_free(ng);
+    ptrie_free(past);
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <ptrie.h>
+
+/***
+ * Microbenchmark for the ptrie. It builds a ptrie out of a 100k-word
+ * corpus and times `ptrie_add`, `ptrie_autocomplete` and `ptrie_lookup`
+ * over it, then freezes it and times `ptrie_lookup` again, and finally
+ * times freeing it. Building the same ptrie with `ptrie_build_bulk` is
+ * timed for comparison. Last, lines of a few words are typed one
+ * character at a time into a ptrie of such lines, to time the lookup
+ * of each keystroke with and without a `ptrie_cursor`.
+ *
+ * Usage: `ptrie_bench.bench [wordlist]`
+ *
+ * The corpus is read from `wordlist` (one word per line, see
+ * `util/mk_wordlist.sh`), or generated with a fixed seed if no file is
+ * given so that runs are comparable.
+ */
+
+#define BENCH_WORDS   100000
+#define BENCH_VOCAB   20000
+#define BENCH_QUERIES 200000
+#define BENCH_WORDLEN 64
+#define BENCH_LINES   2000
+#define BENCH_LINEWORDS 6
+
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//reads up to BENCH_WORDS words from a file, returns how many were read
+static size_t corpus_read(const char* file, char** words){
+    char line[BENCH_WORDLEN];
+    size_t n = 0;
+    FILE* f = fopen(file, "r");
+
+    if(f == NULL){
+        perror(file);
+        exit(EXIT_FAILURE);
+    }
+    while(n < BENCH_WORDS && fgets(line, sizeof(line), f) != NULL){
+        line[strcspn(line, "\n")] = '\0';
+        if(line[0] != '\0'){
+            words[n++] = strdup(line);
+        }
+    }
+    fclose(f);
+
+    return n;
+}
+
+//generates BENCH_WORDS words drawn from a vocabulary of BENCH_VOCAB words, with
+//low-numbered vocabulary words drawn much more often (roughly zipfian)
+static size_t corpus_generate(char** words){
+    static char* vocab[BENCH_VOCAB];
+    char word[BENCH_WORDLEN];
+
+    srand(42);
+    for(size_t i = 0; i < BENCH_VOCAB; i++){
+        size_t len = 3 + rand() % 10;
+
+        //bias the letters so that words share prefixes like real ones do
+        for(size_t j = 0; j < len; j++){
+            int r = rand() % 26;
+            word[j] = 'a' + (r * r) / 26;
+        }
+        word[len] = '\0';
+        vocab[i] = strdup(word);
+    }
+    for(size_t i = 0; i < BENCH_WORDS; i++){
+        double u = (double)rand() / RAND_MAX;
+        words[i] = strdup(vocab[(size_t)(u * u * u * (BENCH_VOCAB - 1))]);
+    }
+    for(size_t i = 0; i < BENCH_VOCAB; i++){
+        free(vocab[i]);
+    }
+
+    return BENCH_WORDS;
+}
+
+int main(int argc, char* argv[]){
+    static char* words[BENCH_WORDS];
+    static char* queries[BENCH_QUERIES];
+    size_t n = argc > 1 ? corpus_read(argv[1], words) : corpus_generate(words);
+    size_t sum = 0;
+    double start;
+
+    if(n == 0){
+        fprintf(stderr, "Empty corpus\n");
+        return EXIT_FAILURE;
+    }
+
+    //the queries are random prefixes of the corpus words, like a user typing
+    for(size_t i = 0; i < BENCH_QUERIES; i++){
+        const char* w = words[rand() % n];
+        queries[i] = strndup(w, 1 + rand() % strlen(w));
+    }
+
+    struct ptrie* pt = ptrie_allocate();
+    start = now();
+    for(size_t i = 0; i < n; i++){
+        ptrie_add(pt, words[i]);
+    }
+    printf("ptrie_add:          %8.1f ns/op (%zu words)\n", (now() - start) * 1e9 / n, n);
+
+    start = now();
+    struct ptrie* bulk = ptrie_build_bulk((const char**)words, n);
+    printf("ptrie_build_bulk:   %8.1f ns/op (%zu words)\n", (now() - start) * 1e9 / n, n);
+    ptrie_free(bulk);
+
+    start = now();
+    for(size_t i = 0; i < BENCH_QUERIES; i++){
+        char* s = ptrie_autocomplete(pt, queries[i]);
+        sum += strlen(s);
+        free(s);
+    }
+    printf("ptrie_autocomplete: %8.1f ns/op (%d prefixes, checksum %zu)\n",
+           (now() - start) * 1e9 / BENCH_QUERIES, BENCH_QUERIES, sum);
+
+    sum = 0;
+    start = now();
+    for(size_t i = 0; i < BENCH_QUERIES; i++){
+        const char* s = ptrie_lookup(pt, queries[i]);
+        sum += s == NULL ? strlen(queries[i]) : strlen(s);
+    }
+    printf("ptrie_lookup:       %8.1f ns/op (%d prefixes, checksum %zu)\n",
+           (now() - start) * 1e9 / BENCH_QUERIES, BENCH_QUERIES, sum);
+
+    //the same lookups once the ptrie is compacted
+    start = now();
+    ptrie_freeze(pt);
+    printf("ptrie_freeze:       %8.1f us\n", (now() - start) * 1e6);
+
+    sum = 0;
+    start = now();
+    for(size_t i = 0; i < BENCH_QUERIES; i++){
+        const char* s = ptrie_lookup(pt, queries[i]);
+        sum += s == NULL ? strlen(queries[i]) : strlen(s);
+    }
+    printf("ptrie_lookup (frozen): %5.1f ns/op (%d prefixes, checksum %zu)\n",
+           (now() - start) * 1e9 / BENCH_QUERIES, BENCH_QUERIES, sum);
+
+    start = now();
+    ptrie_free(pt);
+    printf("ptrie_free:         %8.1f us\n", (now() - start) * 1e6);
+
+    //the lines are typed in another order than they were added
+    static char lines[BENCH_LINES][BENCH_LINEWORDS * BENCH_WORDLEN];
+    struct ptrie* hist = ptrie_allocate();
+    struct ptrie_cursor* cursor = ptrie_cursor_allocate();
+    size_t keys = 0;
+    for(size_t i = 0; i < BENCH_LINES; i++){
+        lines[i][0] = '\0';
+        for(size_t j = 0; j < BENCH_LINEWORDS; j++){
+            strcat(lines[i], words[rand() % n]);
+            strcat(lines[i], j + 1 < BENCH_LINEWORDS ? " " : "");
+        }
+        ptrie_add(hist, lines[i]);
+        keys += strlen(lines[i]);
+    }
+    for(int cursored = 0; cursored <= 1; cursored++){
+        char typed[BENCH_LINEWORDS * BENCH_WORDLEN];
+
+        sum = 0;
+        start = now();
+        for(size_t i = 0; i < BENCH_LINES; i++){
+            const char* line = lines[(i * 7919) % BENCH_LINES];
+
+            for(size_t len = 1; line[len - 1] != '\0'; len++){
+                memcpy(typed, line, len);
+                typed[len] = '\0';
+                const char* s = cursored ? ptrie_cursor_lookup(cursor, hist, typed) : ptrie_lookup(hist, typed);
+                sum += s == NULL ? 0 : strlen(s);
+            }
+        }
+        printf("%s %5.1f ns/key (%zu keystrokes, checksum %zu)\n",
+               cursored ? "ptrie_cursor_lookup:" : "ptrie_lookup (typing):",
+               (now() - start) * 1e9 / keys, keys, sum);
+    }
+    ptrie_cursor_free(cursor);
+    ptrie_free(hist);
+
+    for(size_t i = 0; i < n; i++){
+        free(words[i]);
+    }
+    for(size_t i = 0; i < BENCH_QUERIES; i++){
+        free(queries[i]);
+    }
+
+    return 0;
+}
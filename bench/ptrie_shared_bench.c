@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <ptrie.h>
+
+/***
+ * Benchmark for `ptrie_shared`. One writer thread keeps adding and
+ * removing pairs of strings and publishing, while reader threads query
+ * whichever snapshot is current. `tests/ptrie_shared_test.c` checks
+ * that the snapshots are consistent under the same load.
+ *
+ * Usage: `ptrie_shared_bench.bench [seconds]`
+ */
+
+#define BENCH_READERS 4
+#define BENCH_PAIRS   2000
+#define BENCH_BATCH   16
+#define BENCH_TOPK    8
+
+struct ptrie_shared* shared;
+_Atomic int done;
+
+//the time spent by the calling thread, so that the costs come out right even
+//when the threads share fewer cores than there are of them
+static double now(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//what each thread did, and the time it took
+struct bench_thread{
+    size_t ops;
+    double elapsed;
+};
+
+//adds or removes pairs, publishing every BENCH_BATCH changes, until done
+static void* writer(void* arg){
+    struct ptrie* pt = ptrie_allocate();
+    struct bench_thread* stats = arg;
+    double start = now();
+    unsigned int seed = 1;
+    char a[32], b[32];
+
+    while(!atomic_load(&done)){
+        for(int i = 0; i < BENCH_BATCH; i++){
+            int pair = rand_r(&seed) % BENCH_PAIRS;
+
+            snprintf(a, sizeof(a), "a%d", pair);
+            snprintf(b, sizeof(b), "b%d", pair);
+            if(rand_r(&seed) % 3 == 0 && ptrie_count(pt, a) > 0){
+                ptrie_remove(pt, a);
+                ptrie_remove(pt, b);
+            } else{
+                ptrie_add(pt, a);
+                ptrie_add(pt, b);
+            }
+        }
+        ptrie_add(pt, "version");
+        if(ptrie_shared_publish(shared, pt) == 0){
+            stats->ops++;
+        }
+    }
+    stats->elapsed = now() - start;
+    ptrie_free(pt);
+
+    return NULL;
+}
+
+//queries the snapshots until done
+static void* reader(void* arg){
+    struct bench_thread* stats = arg;
+    double start = now();
+    int slot = ptrie_shared_register(shared);
+    unsigned int seed = slot + 2;
+    const char* out[BENCH_TOPK];
+    char a[32];
+
+    if(slot < 0){
+        return NULL;
+    }
+    while(!atomic_load(&done)){
+        struct ptrie* snap = ptrie_shared_enter(shared, slot);
+
+        if(snap != NULL){
+            snprintf(a, sizeof(a), "a%d", rand_r(&seed) % BENCH_PAIRS);
+            ptrie_count(snap, a);
+            ptrie_count(snap, "version");
+            ptrie_lookup(snap, "a");
+            ptrie_topk(snap, "b", BENCH_TOPK, out);
+        }
+        ptrie_shared_exit(shared, slot);
+        stats->ops++;
+    }
+    stats->elapsed = now() - start;
+    ptrie_shared_unregister(shared, slot);
+
+    return NULL;
+}
+
+int main(int argc, char* argv[]){
+    double seconds = argc > 1 ? atof(argv[1]) : 1;
+    pthread_t readers[BENCH_READERS], writing;
+    struct bench_thread reads[BENCH_READERS] = { 0 }, publishes = { 0 }, total = { 0 };
+    struct timespec run = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+
+    shared = ptrie_shared_allocate();
+    if(shared == NULL){
+        fprintf(stderr, "Could not allocate the shared ptrie\n");
+        return EXIT_FAILURE;
+    }
+
+    pthread_create(&writing, NULL, writer, &publishes);
+    for(int i = 0; i < BENCH_READERS; i++){
+        pthread_create(&readers[i], NULL, reader, &reads[i]);
+    }
+    nanosleep(&run, NULL);
+    atomic_store(&done, 1);
+    pthread_join(writing, NULL);
+    for(int i = 0; i < BENCH_READERS; i++){
+        pthread_join(readers[i], NULL);
+        total.ops += reads[i].ops;
+        total.elapsed += reads[i].elapsed;
+    }
+    ptrie_shared_free(shared);
+
+    //a batch of changes and its publish, and a read of the queries above
+    printf("ptrie_shared_publish: %8.1f us/op (%zu batches of %d changes, up to %d strings)\n",
+           publishes.elapsed * 1e6 / (publishes.ops == 0 ? 1 : publishes.ops), publishes.ops,
+           BENCH_BATCH, 2 * BENCH_PAIRS + 1);
+    printf("ptrie_shared reads:   %8.1f ns/op (%zu reads by %d readers)\n",
+           total.elapsed * 1e9 / (total.ops == 0 ? 1 : total.ops), total.ops, BENCH_READERS);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <epoch.h>
+
+/*
+ * The epoch is a counter that the writer bumps every time it retires an
+ * object, and the object is tagged with the epoch before the bump. A reader
+ * entering a section announces the epoch it saw. An object can only be in use
+ * by a reader that announced an epoch no later than its tag: a reader that saw
+ * a later epoch entered after the object was unpublished. So an object is freed
+ * once every reader inside a section announced a later epoch than its tag.
+ *
+ * The announcements and the swap that unpublishes an object are sequentially
+ * consistent, so that a reader either is seen by the writer's scan, or sees the
+ * new version.
+ */
+
+//a reader's slot, on a cache line of its own so that readers do not slow each
+//other (or the writer) down
+struct epoch_reader{
+    //the epoch announced by the reader inside a section, 0 outside of one
+    _Alignas(64) _Atomic uint64_t epoch;
+    _Atomic int used;
+};
+
+//an object waiting for the readers that might use it
+struct epoch_retired{
+    struct epoch_retired* next;
+    void* obj;
+    void (*destroy)(void*);
+    uint64_t epoch;
+};
+
+struct epoch{
+    struct epoch_reader readers[EPOCH_READERS];
+
+    //starts at 1, so that 0 can mean outside of a section
+    _Atomic uint64_t global;
+
+    //the retired objects, most recently retired first. Only the writer uses them.
+    struct epoch_retired* retired;
+};
+
+struct epoch *epoch_create(void){
+    struct epoch* e = aligned_alloc(_Alignof(struct epoch), sizeof(struct epoch));
+
+    if(e == NULL){
+        return NULL;
+    }
+    for(int i = 0; i < EPOCH_READERS; i++){
+        atomic_init(&e->readers[i].epoch, 0);
+        atomic_init(&e->readers[i].used, 0);
+    }
+    atomic_init(&e->global, 1);
+    e->retired = NULL;
+
+    return e;
+}
+
+void epoch_destroy(struct epoch *e){
+    if(e == NULL){
+        return;
+    }
+    while(e->retired != NULL){
+        struct epoch_retired* r = e->retired;
+
+        e->retired = r->next;
+        r->destroy(r->obj);
+        free(r);
+    }
+    free(e);
+}
+
+int epoch_register(struct epoch *e){
+    for(int i = 0; i < EPOCH_READERS; i++){
+        int unused = 0;
+
+        if(atomic_compare_exchange_strong(&e->readers[i].used, &unused, 1)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+void epoch_unregister(struct epoch *e, int reader){
+    atomic_store(&e->readers[reader].epoch, 0);
+    atomic_store(&e->readers[reader].used, 0);
+}
+
+void epoch_enter(struct epoch *e, int reader){
+    atomic_store(&e->readers[reader].epoch, atomic_load(&e->global));
+}
+
+void epoch_exit(struct epoch *e, int reader){
+    atomic_store_explicit(&e->readers[reader].epoch, 0, memory_order_release);
+}
+
+//the oldest epoch announced by a reader inside a section, UINT64_MAX if none is
+static uint64_t epoch_oldest(struct epoch* e){
+    uint64_t oldest = UINT64_MAX;
+
+    for(int i = 0; i < EPOCH_READERS; i++){
+        uint64_t seen = atomic_load(&e->readers[i].epoch);
+
+        if(seen != 0 && seen < oldest){
+            oldest = seen;
+        }
+    }
+    return oldest;
+}
+
+void epoch_reclaim(struct epoch *e){
+    uint64_t oldest = epoch_oldest(e);
+    struct epoch_retired** ref = &e->retired;
+
+    //tags only grow towards the front of the list, but it is short, so check it all
+    while(*ref != NULL){
+        struct epoch_retired* r = *ref;
+
+        if(r->epoch < oldest){
+            *ref = r->next;
+            r->destroy(r->obj);
+            free(r);
+        } else{
+            ref = &r->next;
+        }
+    }
+}
+
+void epoch_synchronize(struct epoch *e){
+    epoch_reclaim(e);
+    while(e->retired != NULL){
+        sched_yield();
+        epoch_reclaim(e);
+    }
+}
+
+void epoch_retire(struct epoch *e, void *obj, void (*destroy)(void *)){
+    struct epoch_retired* r = malloc(sizeof(struct epoch_retired));
+
+    //without memory to remember it, wait for the readers and free it right away
+    if(r == NULL){
+        uint64_t tag = atomic_fetch_add(&e->global, 1);
+
+        while(epoch_oldest(e) <= tag){
+            sched_yield();
+        }
+        destroy(obj);
+        return;
+    }
+    r->obj = obj;
+    r->destroy = destroy;
+    r->epoch = atomic_fetch_add(&e->global, 1);
+    r->next = e->retired;
+    e->retired = r;
+
+    epoch_reclaim(e);
+}
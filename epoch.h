@@ -0,0 +1,74 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+/***
+ * Epoch-based reclamation, for data-structures that one writer thread
+ * replaces while other threads keep reading them without locks. The
+ * writer publishes a new version with an atomic pointer swap, then
+ * *retires* the old one instead of freeing it: it is only freed once
+ * every reader that could still be looking at it is done.
+ *
+ * Readers bracket each use of the data-structure with `epoch_enter`
+ * and `epoch_exit`, which are a couple of atomic stores and never
+ * block. Only the writer waits, and only for readers that are inside
+ * such a section.
+ */
+struct epoch;
+
+/* Maximum number of readers registered with an epoch at once */
+#define EPOCH_READERS 64
+
+/**
+ * `epoch_create` allocates a new epoch, with no reader registered and
+ * nothing retired.
+ *
+ * - `@return` - The epoch, or `NULL` if it could not be allocated.
+ */
+struct epoch *epoch_create(void);
+
+/**
+ * `epoch_destroy` frees everything still retired, and the epoch
+ * itself. No reader may be inside `epoch_enter` anymore.
+ */
+void epoch_destroy(struct epoch *e);
+
+/**
+ * `epoch_register` reserves a slot for a new reader, which it passes
+ * to `epoch_enter` and `epoch_exit`. A slot must only be used by one
+ * thread at a time.
+ *
+ * - `@return` - The slot, or `-1` if `EPOCH_READERS` are registered.
+ */
+int epoch_register(struct epoch *e);
+
+/**
+ * `epoch_unregister` gives the slot of a reader back, once it is done
+ * reading for good.
+ */
+void epoch_unregister(struct epoch *e, int reader);
+
+/**
+ * `epoch_enter` starts a read-side section: nothing retired after this
+ * is freed until the matching `epoch_exit`. Sections do not nest.
+ */
+void epoch_enter(struct epoch *e, int reader);
+void epoch_exit(struct epoch *e, int reader);
+
+/**
+ * `epoch_retire` hands `obj`, which the writer just unpublished, over
+ * to the epoch, which calls `destroy` on it once no reader can still
+ * be using it. Only the writer may retire objects.
+ */
+void epoch_retire(struct epoch *e, void *obj, void (*destroy)(void *));
+
+/**
+ * `epoch_reclaim` frees the retired objects that no reader can still
+ * be using, without waiting for the others. `epoch_retire` already
+ * calls it, so a writer only has to when it stops publishing for a
+ * while. `epoch_synchronize` waits until every retired object is
+ * freed.
+ */
+void epoch_reclaim(struct epoch *e);
+void epoch_synchronize(struct epoch *e);
+
+#endif /* EPOCH_H */
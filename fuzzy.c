@@ -0,0 +1,524 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fuzzy.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FUZZY_X86
+#endif
+
+//matching is split across threads once there are this many candidates per
+//thread, as starting one costs about as much as scoring that many
+#define FUZZY_MAXTHREADS 8
+#define FUZZY_PER_THREAD 16384
+
+//the prefilter hands the candidates over to scoring in blocks of this many
+#define FUZZY_BLOCK 1024
+
+//what a match scores: each matched character, more for one right after the
+//previous one or at the start of a word, less for the characters skipped
+#define FUZZY_MATCH 16
+#define FUZZY_CONSECUTIVE 8
+#define FUZZY_BOUNDARY 8
+#define FUZZY_GAP_START 3
+#define FUZZY_GAP 1
+
+//the score of a candidate that does not match
+#define FUZZY_NONE INT_MIN
+
+//the table of candidates starts with this many slots, and doubles once half full
+#define FUZZY_TABLE_MIN 1024
+
+struct fuzzy{
+    //the candidates, back to back and NUL-terminated
+    char* pool;
+    size_t pool_len;
+    size_t pool_cap;
+
+    //for each candidate, in the order they were added: where it starts in
+    //`pool`, its length, and the bitmask of the (lowercased) ASCII characters
+    //in it, split in two arrays so that the prefilter loads them as vectors
+    uint32_t* offs;
+    uint32_t* lens;
+    uint64_t* lo;
+    uint64_t* hi;
+    size_t n;
+    size_t cap;
+
+    //for each candidate, how many more times it was added than removed. A
+    //removed one stays in the arrays with a length of 0, which no pattern
+    //matches, until they are compacted once most of them are removed.
+    uint32_t* refs;
+    size_t nremoved;
+
+    //hash table from a candidate to its index plus one (0 for an empty slot),
+    //removed ones included so that adding them again brings them back
+    uint32_t* slots;
+    size_t slots_cap;
+};
+
+//a scored candidate
+struct fuzzy_hit{
+    int score;
+    uint32_t idx;
+};
+
+//one thread's share of a match: the candidates in [from, to), and its best hits
+struct fuzzy_job{
+    struct fuzzy* fz;
+    const char* pattern;
+    size_t plen;
+    int fold;
+    uint64_t plo;
+    uint64_t phi;
+    size_t from;
+    size_t to;
+    size_t k;
+    struct fuzzy_hit* hits;
+    size_t nhits;
+};
+
+static uint64_t hash_str(const char* str){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for(const unsigned char* c = (const unsigned char*)str; *c != '\0'; c++){
+        hash = (hash ^ *c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static char fold_char(char c){
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+//the bitmask of the lowercased ASCII characters in `str`
+static void char_mask(const char* str, uint64_t* lo, uint64_t* hi){
+    *lo = 0;
+    *hi = 0;
+    for(const unsigned char* c = (const unsigned char*)str; *c != '\0'; c++){
+        unsigned char f = (unsigned char)fold_char(*c);
+
+        if(f < 64){
+            *lo |= 1ULL << f;
+        } else if(f < 128){
+            *hi |= 1ULL << (f - 64);
+        }
+    }
+}
+
+struct fuzzy *fuzzy_allocate(void){
+    return calloc(1, sizeof(struct fuzzy));
+}
+
+void fuzzy_free(struct fuzzy *fz){
+    if(fz == NULL){
+        return;
+    }
+    free(fz->pool);
+    free(fz->offs);
+    free(fz->lens);
+    free(fz->lo);
+    free(fz->hi);
+    free(fz->refs);
+    free(fz->slots);
+    free(fz);
+}
+
+void fuzzy_clear(struct fuzzy *fz){
+    fz->n = 0;
+    fz->pool_len = 0;
+    fz->nremoved = 0;
+    if(fz->slots != NULL){
+        memset(fz->slots, 0, fz->slots_cap * sizeof(uint32_t));
+    }
+}
+
+//the slot of the table that holds `str`, or the empty one it would go in
+static uint32_t* str_slot(struct fuzzy* fz, const char* str){
+    size_t mask = fz->slots_cap - 1;
+
+    for(size_t i = hash_str(str) & mask; ; i = (i + 1) & mask){
+        if(fz->slots[i] == 0 || strcmp(fz->pool + fz->offs[fz->slots[i] - 1], str) == 0){
+            return &fz->slots[i];
+        }
+    }
+}
+
+//rebuilds the table with `cap` slots from the candidates
+static int fuzzy_rehash(struct fuzzy* fz, size_t cap){
+    uint32_t* slots = calloc(cap, sizeof(uint32_t));
+
+    if(slots == NULL){
+        return -1;
+    }
+    free(fz->slots);
+    fz->slots = slots;
+    fz->slots_cap = cap;
+    for(size_t i = 0; i < fz->n; i++){
+        *str_slot(fz, fz->pool + fz->offs[i]) = i + 1;
+    }
+    return 0;
+}
+
+//grows the per-candidate arrays to `cap` candidates
+static int fuzzy_grow(struct fuzzy* fz, size_t cap){
+    void* offs = realloc(fz->offs, cap * sizeof(uint32_t));
+    if(offs == NULL){
+        return -1;
+    }
+    fz->offs = offs;
+    void* lens = realloc(fz->lens, cap * sizeof(uint32_t));
+    if(lens == NULL){
+        return -1;
+    }
+    fz->lens = lens;
+    void* lo = realloc(fz->lo, cap * sizeof(uint64_t));
+    if(lo == NULL){
+        return -1;
+    }
+    fz->lo = lo;
+    void* hi = realloc(fz->hi, cap * sizeof(uint64_t));
+    if(hi == NULL){
+        return -1;
+    }
+    fz->hi = hi;
+    void* refs = realloc(fz->refs, cap * sizeof(uint32_t));
+    if(refs == NULL){
+        return -1;
+    }
+    fz->refs = refs;
+    fz->cap = cap;
+
+    return 0;
+}
+
+int fuzzy_add(struct fuzzy *fz, const char *str){
+    size_t len = strlen(str);
+
+    if((fz->n + 1) * 2 > fz->slots_cap &&
+       fuzzy_rehash(fz, fz->slots_cap == 0 ? FUZZY_TABLE_MIN : fz->slots_cap * 2) != 0){
+        return -1;
+    }
+
+    //a candidate already there is only counted again, or brought back
+    uint32_t* slot = str_slot(fz, str);
+    if(*slot != 0){
+        uint32_t i = *slot - 1;
+
+        if(fz->refs[i]++ == 0){
+            fz->lens[i] = len;
+            char_mask(str, &fz->lo[i], &fz->hi[i]);
+            fz->nremoved--;
+        }
+        return 0;
+    }
+
+    if(fz->pool_len + len + 1 > UINT32_MAX){
+        return -1;
+    }
+    if(fz->pool_len + len + 1 > fz->pool_cap){
+        size_t cap = fz->pool_cap == 0 ? 4096 : fz->pool_cap;
+
+        while(cap < fz->pool_len + len + 1){
+            cap *= 2;
+        }
+        char* pool = realloc(fz->pool, cap);
+        if(pool == NULL){
+            return -1;
+        }
+        fz->pool = pool;
+        fz->pool_cap = cap;
+    }
+    if(fz->n == fz->cap && fuzzy_grow(fz, fz->cap == 0 ? 256 : fz->cap * 2) != 0){
+        return -1;
+    }
+
+    memcpy(fz->pool + fz->pool_len, str, len + 1);
+    fz->offs[fz->n] = fz->pool_len;
+    fz->lens[fz->n] = len;
+    char_mask(str, &fz->lo[fz->n], &fz->hi[fz->n]);
+    fz->refs[fz->n] = 1;
+    fz->pool_len += len + 1;
+    *slot = ++fz->n;
+
+    return 0;
+}
+
+//drops the removed candidates, keeping the others in the order they were added
+static void fuzzy_compact(struct fuzzy* fz){
+    size_t n = 0, pool_len = 0;
+
+    for(size_t i = 0; i < fz->n; i++){
+        if(fz->refs[i] == 0){
+            continue;
+        }
+        memmove(fz->pool + pool_len, fz->pool + fz->offs[i], fz->lens[i] + 1);
+        fz->offs[n] = pool_len;
+        fz->lens[n] = fz->lens[i];
+        fz->lo[n] = fz->lo[i];
+        fz->hi[n] = fz->hi[i];
+        fz->refs[n] = fz->refs[i];
+        pool_len += fz->lens[i] + 1;
+        n++;
+    }
+    fz->n = n;
+    fz->pool_len = pool_len;
+    fz->nremoved = 0;
+
+    //the table is the same size, so this cannot fail
+    memset(fz->slots, 0, fz->slots_cap * sizeof(uint32_t));
+    for(size_t i = 0; i < fz->n; i++){
+        *str_slot(fz, fz->pool + fz->offs[i]) = i + 1;
+    }
+}
+
+int fuzzy_remove(struct fuzzy *fz, const char *str){
+    uint32_t* slot = fz->slots == NULL ? NULL : str_slot(fz, str);
+
+    if(slot == NULL || *slot == 0 || fz->refs[*slot - 1] == 0){
+        return -1;
+    }
+
+    //the last removal hides it from matching
+    uint32_t i = *slot - 1;
+    if(--fz->refs[i] == 0){
+        fz->lens[i] = 0;
+        fz->lo[i] = 0;
+        fz->hi[i] = 0;
+        if(++fz->nremoved * 2 > fz->n){
+            fuzzy_compact(fz);
+        }
+    }
+    return 0;
+}
+
+//the candidates in [from, to) that have every character of the pattern,
+//written to `out`, returns how many there are
+static size_t prefilter_scalar(const uint64_t* lo, const uint64_t* hi, size_t from, size_t to,
+                               uint64_t plo, uint64_t phi, uint32_t* out){
+    size_t n = 0;
+
+    for(size_t i = from; i < to; i++){
+        if((lo[i] & plo) == plo && (hi[i] & phi) == phi){
+            out[n++] = i;
+        }
+    }
+    return n;
+}
+
+#ifdef FUZZY_X86
+//four candidates at a time: both halves of each mask have to contain the pattern's
+__attribute__((target("avx2")))
+static size_t prefilter_avx2(const uint64_t* lo, const uint64_t* hi, size_t from, size_t to,
+                             uint64_t plo, uint64_t phi, uint32_t* out){
+    __m256i wlo = _mm256_set1_epi64x(plo);
+    __m256i whi = _mm256_set1_epi64x(phi);
+    size_t n = 0;
+    size_t i = from;
+
+    for(; i + 4 <= to; i += 4){
+        __m256i l = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(lo + i)), wlo);
+        __m256i h = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(hi + i)), whi);
+        __m256i ok = _mm256_and_si256(_mm256_cmpeq_epi64(l, wlo), _mm256_cmpeq_epi64(h, whi));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(ok));
+
+        while(mask != 0){
+            out[n++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+    return n + prefilter_scalar(lo, hi, i, to, plo, phi, out + n);
+}
+#endif
+
+//the kernel for this CPU, picked before main runs so that threads never race on it
+static size_t (*prefilter)(const uint64_t*, const uint64_t*, size_t, size_t, uint64_t, uint64_t, uint32_t*) = prefilter_scalar;
+
+__attribute__((constructor))
+static void prefilter_select(void){
+#ifdef FUZZY_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+        prefilter = prefilter_avx2;
+    }
+#endif
+}
+
+static int is_boundary(char c){
+    return c == ' ' || c == '/' || c == '-' || c == '_' || c == '.' || c == '=' || c == ':';
+}
+
+//scores `str` against the pattern (already lowercased if `fold`), FUZZY_NONE if
+//it does not hold the pattern's characters in order
+static int fuzzy_score(const char* str, size_t len, const char* pattern, size_t plen, int fold){
+    size_t j = 0;
+    size_t start, end = 0;
+
+    //the first place the whole pattern has been seen by
+    for(size_t i = 0; i < len; i++){
+        if((fold ? fold_char(str[i]) : str[i]) == pattern[j] && ++j == plen){
+            end = i + 1;
+            break;
+        }
+    }
+    if(j < plen){
+        return FUZZY_NONE;
+    }
+
+    //then back from there, for the shortest stretch holding it
+    start = end;
+    while(j > 0){
+        start--;
+        if((fold ? fold_char(str[start]) : str[start]) == pattern[j - 1]){
+            j--;
+        }
+    }
+
+    //and score that stretch
+    int score = 0;
+    int consecutive = 0;
+    for(size_t i = start; i < end && j < plen; i++){
+        if((fold ? fold_char(str[i]) : str[i]) == pattern[j]){
+            score += FUZZY_MATCH;
+            if(i == 0 || is_boundary(str[i - 1])){
+                score += FUZZY_BOUNDARY;
+            }
+            if(consecutive){
+                score += FUZZY_CONSECUTIVE;
+            }
+            consecutive = 1;
+            j++;
+        } else{
+            score -= consecutive ? FUZZY_GAP_START : FUZZY_GAP;
+            consecutive = 0;
+        }
+    }
+    return score;
+}
+
+//higher score first, then shorter, then added first
+static int hit_better(struct fuzzy* fz, struct fuzzy_hit a, struct fuzzy_hit b){
+    if(a.score != b.score){
+        return a.score > b.score;
+    }
+    if(fz->lens[a.idx] != fz->lens[b.idx]){
+        return fz->lens[a.idx] < fz->lens[b.idx];
+    }
+    return a.idx < b.idx;
+}
+
+//inserts `hit` into the sorted `hits`, if it is among the `k` best
+static void hits_offer(struct fuzzy* fz, struct fuzzy_hit* hits, size_t* n, size_t k, struct fuzzy_hit hit){
+    if(*n == k && !hit_better(fz, hit, hits[k - 1])){
+        return;
+    }
+
+    size_t i = *n < k ? (*n)++ : k - 1;
+    while(i > 0 && hit_better(fz, hit, hits[i - 1])){
+        hits[i] = hits[i - 1];
+        i--;
+    }
+    hits[i] = hit;
+}
+
+//matches the candidates of a job, a block at a time
+static void* fuzzy_run(void* arg){
+    struct fuzzy_job* job = arg;
+    struct fuzzy* fz = job->fz;
+    uint32_t block[FUZZY_BLOCK];
+
+    for(size_t from = job->from; from < job->to; from += FUZZY_BLOCK){
+        size_t to = from + FUZZY_BLOCK < job->to ? from + FUZZY_BLOCK : job->to;
+        size_t n = prefilter(fz->lo, fz->hi, from, to, job->plo, job->phi, block);
+
+        for(size_t i = 0; i < n; i++){
+            struct fuzzy_hit hit = { .idx = block[i] };
+
+            if(fz->lens[hit.idx] < job->plen){
+                continue;
+            }
+            hit.score = fuzzy_score(fz->pool + fz->offs[hit.idx], fz->lens[hit.idx], job->pattern, job->plen, job->fold);
+            if(hit.score != FUZZY_NONE){
+                hits_offer(fz, job->hits, &job->nhits, job->k, hit);
+            }
+        }
+    }
+    return NULL;
+}
+
+size_t fuzzy_match(struct fuzzy *fz, const char *pattern, size_t k, const char **out){
+    struct fuzzy_job jobs[FUZZY_MAXTHREADS];
+    pthread_t threads[FUZZY_MAXTHREADS];
+    int started[FUZZY_MAXTHREADS] = { 0 };
+    size_t plen = strlen(pattern);
+    size_t njobs = fz->n / FUZZY_PER_THREAD + 1;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int fold = 1;
+
+    if(k == 0 || plen == 0 || fz->n == 0){
+        return 0;
+    }
+
+    //smart case: an uppercase letter in the pattern makes case matter
+    char* folded = malloc(plen + 1);
+    struct fuzzy_hit* hits = malloc((FUZZY_MAXTHREADS + 1) * k * sizeof(struct fuzzy_hit));
+    if(folded == NULL || hits == NULL){
+        free(folded);
+        free(hits);
+        return 0;
+    }
+    for(size_t i = 0; i <= plen; i++){
+        fold = fold && !(pattern[i] >= 'A' && pattern[i] <= 'Z');
+    }
+    for(size_t i = 0; i <= plen; i++){
+        folded[i] = fold ? fold_char(pattern[i]) : pattern[i];
+    }
+
+    //split the candidates evenly, with no more threads than cores
+    if(njobs > FUZZY_MAXTHREADS){
+        njobs = FUZZY_MAXTHREADS;
+    }
+    if(cpus > 0 && njobs > (size_t)cpus){
+        njobs = cpus;
+    }
+    for(size_t i = 0; i < njobs; i++){
+        jobs[i] = (struct fuzzy_job){
+            .fz = fz, .pattern = folded, .plen = plen, .fold = fold,
+            .from = fz->n * i / njobs, .to = fz->n * (i + 1) / njobs,
+            .k = k, .hits = hits + (i + 1) * k,
+        };
+        char_mask(folded, &jobs[i].plo, &jobs[i].phi);
+    }
+
+    //the first share is matched in this thread, and so are those no thread could be started for
+    for(size_t i = 1; i < njobs; i++){
+        started[i] = pthread_create(&threads[i], NULL, fuzzy_run, &jobs[i]) == 0;
+    }
+    fuzzy_run(&jobs[0]);
+    for(size_t i = 1; i < njobs; i++){
+        if(started[i]){
+            pthread_join(threads[i], NULL);
+        } else{
+            fuzzy_run(&jobs[i]);
+        }
+    }
+
+    //merge the best of each share
+    size_t n = 0;
+    for(size_t i = 0; i < njobs; i++){
+        for(size_t j = 0; j < jobs[i].nhits; j++){
+            hits_offer(fz, hits, &n, k, jobs[i].hits[j]);
+        }
+    }
+    for(size_t i = 0; i < n; i++){
+        out[i] = fz->pool + fz->offs[hits[i].idx];
+    }
+    free(folded);
+    free(hits);
+
+    return n;
+}
@@ -0,0 +1,77 @@
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <stddef.h>
+
+/***
+ * The fuzzy matcher finds the strings that contain the characters of a
+ * pattern in order, but not necessarily next to each other (`gco`
+ * matches `git checkout`), and ranks them by how well they match, the
+ * way fzf does. It complements the prefix matching of the ptrie for
+ * fragments typed from the middle of a long command.
+ *
+ * The candidates are kept in flat arrays, so that matching scans them
+ * sequentially: a vectorized prefilter first drops the candidates
+ * missing one of the pattern's characters, using a bitmask of the
+ * characters in each, and only the rest are scored. Many candidates
+ * are split across threads.
+ */
+struct fuzzy;
+
+/**
+ * `fuzzy_allocate` allocates a new matcher with no candidates, `NULL`
+ * if it could not be, and `fuzzy_free` frees it.
+ */
+struct fuzzy *fuzzy_allocate(void);
+void fuzzy_free(struct fuzzy *fz);
+
+/**
+ * `fuzzy_add` adds a candidate, copying it into the matcher. Adding
+ * one that is already there only counts it again, it is still matched
+ * once.
+ *
+ * - `@fz` - The matcher.
+ * - `@str` - The candidate, *borrowed* from the caller.
+ * - `@return` - `0` on success, `-1` on `malloc` failure.
+ */
+int fuzzy_add(struct fuzzy *fz, const char *str);
+
+/**
+ * `fuzzy_remove` takes back one `fuzzy_add` of a candidate, which is
+ * no longer matched once it was removed as many times as it was
+ * added. This takes amortized constant time, so that candidates can follow a
+ * changing set of strings rather than be added all over again.
+ *
+ * - `@fz` - The matcher.
+ * - `@str` - The candidate, *borrowed* from the caller.
+ * - `@return` - `0` on success, `-1` if `str` is not a candidate.
+ */
+int fuzzy_remove(struct fuzzy *fz, const char *str);
+
+/**
+ * `fuzzy_clear` removes every candidate, keeping the memory for the
+ * next ones.
+ */
+void fuzzy_clear(struct fuzzy *fz);
+
+/**
+ * `fuzzy_match` finds the `k` best matches of `pattern`. A match
+ * scores more for characters that are next to each other or start a
+ * word, and less for gaps between them. Equal scores go to the shorter
+ * candidate, then to the one added first. If `pattern` has no
+ * uppercase letter, case is ignored. An empty pattern matches nothing.
+ *
+ * Arguments:
+ *
+ * - `@fz` - The matcher.
+ * - `@pattern` - The characters to look for, in order.
+ * - `@k` - The maximum number of matches to return.
+ * - `@out` - An array of at least `k` entries that is filled with the
+ *     matches, best first. The strings are *borrowed* from the
+ *     matcher, and valid until the next `fuzzy_add`, `fuzzy_remove`,
+ *     `fuzzy_clear` or `fuzzy_free`.
+ * - `@return` - The number of matches placed in `out`.
+ */
+size_t fuzzy_match(struct fuzzy *fz, const char *pattern, size_t k, const char **out);
+
+#endif /* FUZZY_H */
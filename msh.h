@@ -1,11 +1,10 @@
 #pragma once
 
-/* Maximum number of background pipelines */
-#define MSH_MAXBACKGROUND 16
-/* each command can have MSH_MAXARGS or fewer arguments */
-#define MSH_MAXARGS  16
-/* each pipeline has MSH_MAXCMNDS or fewer commands */
-#define MSH_MAXCMNDS 16
+/*
+ * There is no limit on the arguments of a command, the commands of a
+ * pipeline, the pipelines of a sequence, or the background pipelines:
+ * they all grow as needed.
+ */
 
 /**
  * A sequence of pipelines. Pipelines are separated by ";"s, enabling
@@ -44,9 +43,9 @@ typedef enum {
 	MSH_ERR_NO_REDIR_FILE = -4,
 	/* pipeline processes ran out of memory */
 	MSH_ERR_NOMEM = -5,
-	/* More than MSH_MAXARGS passed to a command */
+	/* Too many arguments passed to a command (no longer returned, there is no limit) */
 	MSH_ERR_TOO_MANY_ARGS = -6,
-	/* More than MSH_MAXCMNDS in a pipeline */
+	/* Too many commands in a pipeline (no longer returned, there is no limit) */
 	MSH_ERR_TOO_MANY_CMDS = -7,
 	/* Pipe either does not have a preceding command or a following command */
 	MSH_ERR_PIPE_MISSING_CMD = -8,
@@ -59,8 +58,10 @@ typedef enum {
 	 * background, yet is missing a command
 	 */
 	MSH_ERR_SEQ_REDIR_OR_BACKGROUND_MISSING_CMD = -11,
-	/* The sequence still has pipelines, cannot add more  */
+	/* The sequence still has pipelines, cannot add more (no longer returned, parsing appends to a non-empty sequence) */
 	MSH_ERR_SEQ_BUSY = -12,
+	/* A pipeline in a sequence is empty, e.g. "cmd ; ; cmd" or "; cmd" */
+	MSH_ERR_SEQ_MISSING_CMD = -13,
 } msh_err_t;
 
 /* Return a human-readable string corresponding to an msh error */
@@ -80,7 +81,8 @@ msh_pipeline_err2str(msh_err_t e)
 		"Could not execute program",
 		"Attempted to redirect output to pipe and to file redirection",
 		"A pipeline has a redirection or &, but no command",
-		"Attempted to parse into sequence, when it still has pipelines"
+		"Attempted to parse into sequence, when it still has pipelines (no longer returned)",
+		"A pipeline in the sequence has no command"
 	};
 
 	return strs[-e];
@@ -96,6 +98,7 @@ void msh_init(void);
 /**
  * `msh_execute` is called with the parsed pipeline for the shell to
  * execute. If the pipeline doesn't run in the background, this will
- * only return after the pipeline completes.
+ * only return after the pipeline completes. Passing `NULL` frees the
+ * pipelines still running in the background, before exiting.
  */
 void msh_execute(struct msh_pipeline *p);
@@ -11,10 +11,17 @@
 
 
 struct proc_data{
+	//the pid of the command's process, MSH_REAPED once it has been reaped
 	pid_t proc_pid;
 };
 
-struct msh_pipeline* background[MSH_MAXBACKGROUND] = {NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL}; //make these null
+#define MSH_REAPED -1
+
+//the background pipelines by job number, and how many there is room for. There is
+//always room for one more than `pl_count`, so that the SIGTSTP handler can put the
+//foreground there without allocating.
+struct msh_pipeline** background = NULL;
+unsigned int background_cap = 0;
 unsigned int pl_count = 0;
 struct msh_pipeline* foreground;
 pid_t pid;
@@ -28,6 +35,45 @@ struct msh_command* wait_c;
 char* std_out = NULL;
 char* std_err = NULL;
 
+//makes room in `background` for the pipeline about to run, and for a stopped
+//foreground after it, doubling it when it is full
+static int background_reserve(void){
+	sigset_t masked, old;
+	unsigned int cap = background_cap == 0 ? 16 : background_cap;
+
+	while(pl_count + 2 > cap){
+		cap *= 2;
+	}
+	if(cap == background_cap){
+		return 0;
+	}
+
+	//the SIGTSTP handler must not see the table while it moves
+	sigemptyset(&masked);
+	sigaddset(&masked, SIGTSTP);
+	sigprocmask(SIG_BLOCK, &masked, &old);
+	struct msh_pipeline** grown = realloc(background, cap * sizeof(struct msh_pipeline*));
+	if(grown != NULL){
+		memset(grown + background_cap, 0, (cap - background_cap) * sizeof(struct msh_pipeline*));
+		background = grown;
+		background_cap = cap;
+	}
+	sigprocmask(SIG_SETMASK, &old, NULL);
+
+	return grown == NULL ? -1 : 0;
+}
+
+//the first free job number. Jobs end in any order, so it can be below `pl_count`,
+//and there is always one below `background_cap`.
+static unsigned int background_slot(void){
+	unsigned int i = 0;
+
+	while(background[i] != NULL){
+		i++;
+	}
+	return i;
+}
+
 int msh_wait(pid_t process_id, int block){
 	pid_t ret;
 	int options = 0;
@@ -79,50 +125,58 @@ void foreground_wait(){
 		
 	}
 }
+//marks the background command whose process was reaped. It runs in the SIGTSTP
+//handler too, so it only marks it: the finished pipelines are freed by
+//`free_reaped`, outside of the handler.
 void check_bg(pid_t reaped_pid){
 	struct msh_command* wait_c;
 	struct proc_data* pd;
 
-	//check every background pipeline
-	for(unsigned int i = 0; i < MSH_MAXBACKGROUND; i++ ){
+	//check every command of every background pipeline
+	for(unsigned int i = 0; i < background_cap; i++ ){
 		if(background[i] == NULL){
 			continue;
 		}
-		unsigned int cmd_count = 0;
-		wait_c = msh_pipeline_command(background[i], cmd_count);
-
-		//iterate through every command
-		while(wait_c != NULL){
-
-			//get the pid of the command
+		for(size_t cmd_count = 0; (wait_c = msh_pipeline_command(background[i], cmd_count)) != NULL; cmd_count++){
 			pd = msh_command_getdata(wait_c);
-
-			//if we reaped that command,set the pid to -1
-			if(pd->proc_pid == reaped_pid){
-				msh_command_putdata(wait_c, NULL, free);
+			if(pd != NULL && pd->proc_pid == reaped_pid){
+				pd->proc_pid = MSH_REAPED;
+				return;
 			}
+		}
+	}
+}
 
-			//if we didn't reap it, break out we are still waiting
-			if((pd = msh_command_getdata(wait_c)) != NULL){
-				break;
-			}
+//whether every command of `p` has been reaped
+static int reaped(struct msh_pipeline* p){
+	struct msh_command* c;
+	struct proc_data* pd;
 
-			//if we reaped everything, free the background
-			if(msh_command_final(wait_c) == 1){
-				msh_pipeline_free(background[i]);
-				background[i] = NULL;
-				pl_count--;
-				break;
-				
-			}
+	for(size_t i = 0; (c = msh_pipeline_command(p, i)) != NULL; i++){
+		pd = msh_command_getdata(c);
+		if(pd != NULL && pd->proc_pid != MSH_REAPED){
+			return 0;
+		}
+	}
+	return 1;
+}
 
-			//get next command
-			cmd_count++;
-			if(background[i] != NULL){
-				wait_c = msh_pipeline_command(background[i], cmd_count);
-			}
+//frees the background pipelines that have finished, with SIGTSTP blocked so that
+//its handler does not see the table change
+static void free_reaped(void){
+	sigset_t masked, old;
+
+	sigemptyset(&masked);
+	sigaddset(&masked, SIGTSTP);
+	sigprocmask(SIG_BLOCK, &masked, &old);
+	for(unsigned int i = 0; i < background_cap; i++){
+		if(background[i] != NULL && reaped(background[i])){
+			msh_pipeline_free(background[i]);
+			background[i] = NULL;
+			pl_count--;
 		}
 	}
+	sigprocmask(SIG_SETMASK, &old, NULL);
 }
 
 void wait_but_dont_block(){
@@ -131,6 +185,7 @@ void wait_but_dont_block(){
 		check_bg(data_pid);
 		fflush(stdout);	
 	}
+	free_reaped();
 }
 
 int append_or_trunc(char** args){
@@ -148,6 +203,23 @@ int append_or_trunc(char** args){
 	return -1;
 }
 
+//the args of `c` before the redirection `redir`, NULL-terminated, to run the program with
+static char** args_before(struct msh_command* c, const char* redir){
+	char** args = msh_command_args(c);
+	size_t n = 0;
+
+	while(args[n] != NULL && strcmp(args[n], redir) != 0){
+		n++;
+	}
+	char** before = calloc(n + 1, sizeof(char*));
+	if(before == NULL){
+		exit(1);
+	}
+	memcpy(before, args, n * sizeof(char*));
+
+	return before;
+}
+
 void check_file_output(struct msh_command* c){
 	int fd;
 	int action;
@@ -162,13 +234,7 @@ void check_file_output(struct msh_command* c){
 		if(action == 0){
 			fd = open(std_out, O_WRONLY | O_CREAT | O_TRUNC, 0700);
 			dup2(fd, STDOUT_FILENO);
-			char** new_args = malloc(256);
-			for(unsigned int i = 0; msh_command_args(c)[i] != NULL; i++){
-				if(strcmp(msh_command_args(c)[i], "1>") == 0){
-					break;
-				}
-				new_args[i] = msh_command_args(c)[i];
-			}
+			char** new_args = args_before(c, "1>");
 			execvp(msh_command_program(c), new_args);
 		}
 		//append
@@ -176,13 +242,7 @@ void check_file_output(struct msh_command* c){
 			fd = open(std_out, O_WRONLY | O_CREAT, 0700);
 			lseek(fd, 0, SEEK_END);
 			dup2(fd, STDOUT_FILENO);
-			char** new_args = malloc(256);
-			for(unsigned int i = 0; msh_command_args(c)[i] != NULL; i++){
-				if(strcmp(msh_command_args(c)[i], "1>>") == 0){
-					break;
-				}
-				new_args[i] = msh_command_args(c)[i];
-			}
+			char** new_args = args_before(c, "1>>");
 			execvp(msh_command_program(c), new_args);
 		}
 	}
@@ -192,13 +252,7 @@ void check_file_output(struct msh_command* c){
 		if(action == 0){
 			fd = open(std_err, O_WRONLY | O_CREAT | O_TRUNC, 0700);
 			dup2(fd, STDERR_FILENO);
-			char** new_args = malloc(256);
-			for(unsigned int i = 0; msh_command_args(c)[i] != NULL; i++){
-				if(strcmp(msh_command_args(c)[i], "2>") == 0){
-					break;
-				}
-				new_args[i] = msh_command_args(c)[i];
-			}
+			char** new_args = args_before(c, "2>");
 			execvp(msh_command_program(c), new_args);
 		}
 		//append
@@ -206,13 +260,7 @@ void check_file_output(struct msh_command* c){
 			fd = open(std_err, O_WRONLY | O_CREAT, 0700);
 			lseek(fd, 0, SEEK_END);
 			dup2(fd, STDERR_FILENO);
-			char** new_args = malloc(256);
-			for(unsigned int i = 0; msh_command_args(c)[i] != NULL; i++){
-				if(strcmp(msh_command_args(c)[i], "2>>") == 0){
-					break;
-				}
-				new_args[i] = msh_command_args(c)[i];
-			}
+			char** new_args = args_before(c, "2>>");
 			execvp(msh_command_program(c), new_args);
 		}
 	}
@@ -391,16 +439,25 @@ void fork_and_exec(struct msh_pipeline* p){
 
 void msh_execute(struct msh_pipeline *p){
 	if(p == NULL){
-		for(unsigned int i = 0; i < MSH_MAXBACKGROUND; i++){
+		for(unsigned int i = 0; i < background_cap; i++){
 			if(background[i] != NULL){
-				free(background[i]);
+				msh_pipeline_free(background[i]);
 				background[i] = NULL;
 			}
 		}
+		free(background);
+		background = NULL;
+		background_cap = 0;
 		return;
 	}
 	struct msh_command* c = msh_pipeline_command(p, 0);
 
+	if(background_reserve() != 0){
+		printf("MSH Error: %s\n", msh_pipeline_err2str(MSH_ERR_NOMEM));
+		msh_pipeline_free(p);
+		return;
+	}
+
 	if(strcmp(msh_command_program(c), "cd") == 0){
 		if(strcmp(msh_command_args(c)[1], "~") == 0){
 			chdir(getenv("HOME"));
@@ -416,26 +473,35 @@ void msh_execute(struct msh_pipeline *p){
 		exit(1);
 	}
 
-	//bg
+	//bg, the builtins free their own pipeline as they have no processes to wait for
 	else if(strcmp(msh_command_program(c), "bg") == 0){
-	
+		msh_pipeline_free(p);
+		return;
 	}
 
 	//fg
 	else if(strcmp(msh_command_program(c), "fg") == 0){
 		if(pl_count == 0){
+			msh_pipeline_free(p);
 			return;
 		}
 		
+		//the job given, or the last one
+		unsigned int job = background_cap;
 		if(msh_command_args(c)[1] != NULL){
-			foreground = background[atoi(msh_command_args(c)[1])];
-			background[atoi(msh_command_args(c)[1])] = NULL;
-
+			job = atoi(msh_command_args(c)[1]);
 		}
 		else{
-			foreground = background[pl_count - 1];
-			background[pl_count - 1] = NULL;
+			while(job > 0 && background[job - 1] == NULL){
+				job--;
+			}
+			job--;
 		}
+		foreground = job < background_cap ? background[job] : NULL;
+		if(foreground != NULL){
+			background[job] = NULL;
+		}
+		msh_pipeline_free(p);
 		if(foreground == NULL){
 			return;
 		}
@@ -444,15 +510,19 @@ void msh_execute(struct msh_pipeline *p){
 		wait_c = msh_pipeline_command(foreground, cmd_count);
 		while(wait_c != NULL){
 			wait_c_pd = msh_command_getdata(wait_c);
-			wait_c_pd_pid = wait_c_pd->proc_pid;
 			printf("%s\n", msh_pipeline_input(foreground));
-			while((data_pid = waitpid(wait_c_pd_pid, NULL, 0) == 1));
-			if(errno == EINTR){
-				msh_pipeline_free(foreground);
-				if(pl_count > 0){
-					pl_count--;
+
+			//a command reaped in the background is not waited for again
+			if(wait_c_pd != NULL && wait_c_pd->proc_pid != MSH_REAPED){
+				wait_c_pd_pid = wait_c_pd->proc_pid;
+				while((data_pid = waitpid(wait_c_pd_pid, NULL, 0) == 1));
+				if(errno == EINTR){
+					msh_pipeline_free(foreground);
+					if(pl_count > 0){
+						pl_count--;
+					}
+					return;
 				}
-				return;
 			}
 			cmd_count++;
 			wait_c = msh_pipeline_command(foreground, cmd_count);
@@ -468,10 +538,11 @@ void msh_execute(struct msh_pipeline *p){
 
 	//jobs
 	else if(strcmp(msh_command_program(c), "jobs") == 0){
+		msh_pipeline_free(p);
 		if(pl_count == 0){
 			return;
 		}
-		for(unsigned int i = 0; i < MSH_MAXBACKGROUND; i++){
+		for(unsigned int i = 0; i < background_cap; i++){
 			if(background[i] == NULL || msh_pipeline_input(background[i]) == NULL){
 				continue;
 			}
@@ -497,7 +568,7 @@ void msh_execute(struct msh_pipeline *p){
 	//if the pipeline is in the foreground
 	if(msh_pipeline_background(p) == 1){
 		//put it in the background
-		background[pl_count] = p;
+		background[background_slot()] = p;
 		pl_count++;
 		
 	}
@@ -535,10 +606,12 @@ void sig_handler(int signal_number, siginfo_t *info, void *context){
 	(void)(info);
     switch(signal_number){
     case SIGTSTP: {
-		//ctrl + z
-		background[pl_count] = foreground;
-		pl_count++;
-		foreground = NULL;
+		//ctrl + z, the table has room for the foreground while there is one
+		if(foreground != NULL){
+			background[background_slot()] = foreground;
+			pl_count++;
+			foreground = NULL;
+		}
 
 		while((data_pid = waitpid(0, NULL, WNOHANG)) != -1 && data_pid != 0){
 			check_bg(data_pid);
@@ -568,9 +641,11 @@ void sig_handler(int signal_number, siginfo_t *info, void *context){
 		}
 		while(msh_command_final(c) != 1){
 				
-			//kill the child
+			//kill the child, unless it was reaped already
 			pd = msh_command_getdata(c);
-			kill(pd->proc_pid, SIGTERM);
+			if(pd != NULL && pd->proc_pid != MSH_REAPED){
+				kill(pd->proc_pid, SIGTERM);
+			}
 
 			//increment the count
 			cmd_count = cmd_count + 1;
@@ -579,7 +654,7 @@ void sig_handler(int signal_number, siginfo_t *info, void *context){
 
 		//kill the final child
 		pd = msh_command_getdata(c);
-		if(pd == NULL || pd->proc_pid == 0){
+		if(pd == NULL || pd->proc_pid == 0 || pd->proc_pid == MSH_REAPED){
 			return;
 		}
 		kill(pd->proc_pid, SIGTERM);
@@ -8,105 +8,737 @@
 #include <signal.h>
 #include <sys/wait.h>
 #include <ptrie.h>
+#include <fuzzy.h>
+#include <ngram.h>
+#include <argtrie.h>
 #include <dirent.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <errno.h>
+
+/* Maximum number of completions offered for a single Tab press */
+#define MSH_MAXCOMPLETIONS 16
+/* Maximum number of threads scanning the path directories in parallel */
+#define MSH_MAXSCANNERS 8
+/* Memory budget of the past entries in bytes, unless $MSH_HISTORY_BUDGET sets another (0 for none) */
+#define MSH_HISTORY_BUDGET (4 << 20)
+/* Half-life in seconds of how much running a command counts towards suggesting it */
+#define MSH_HISTORY_HALFLIFE (24 * 60 * 60)
+/* Memory budget in bytes of the arguments learned for each program at each position */
+#define MSH_ARGS_BUDGET (64 << 10)
+/* Most programs whose arguments are learned, the least used are forgotten past it */
+#define MSH_ARGS_PROGRAMS 64
+/* Starting a line with this (Ctrl-R) searches the past entries for the rest of it */
+#define MSH_SEARCH_KEY '\x12'
 
 //ptrie to hold past entries
 struct ptrie* past;
 
-//ptrie to hold path variable program
-struct ptrie* path_vars;
+//cursors for the hints into `past` and `path_vars`, so that each keystroke only
+//walks the characters that changed
+struct ptrie_cursor *past_cursor;
+struct ptrie_cursor *path_cursor;
+
+//every past entry and path program, for fuzzy completion, and the version of the
+//`path_vars` snapshot it was copied from. Past entries are added and removed as
+//`past` changes, the path programs are copied again when the snapshot changes.
+struct fuzzy *fuzzy_index;
+uint64_t fuzzy_path_version;
+
+//every past entry by the substrings it holds, for reverse-i-search, ranked like
+//`past` ranks it, and the hint showing the best match
+struct ngram *history_index;
+char search_hint[256];
+
+//the arguments each program was run with, by position, to complete the word being typed,
+//and the sequence the buffer is parsed into to find that word
+struct argtrie *args_index;
+struct msh_sequence *args_seq;
+
+//ptrie to hold path variable program. It is built and kept up to date by a
+//background thread, which publishes a snapshot of it here after every change,
+//so the callbacks read it without ever waiting. There is no snapshot until the
+//programs have been read.
+struct ptrie_shared *path_vars;
+pthread_t path_vars_thread;
+
+//the reader slot of the main thread in `path_vars`, -1 if it has none
+int path_vars_reader = -1;
+
+//the hint taken from `path_vars`, copied as the snapshot can go away once left
+char path_hint[NAME_MAX + 1];
+
+//the path directories, watched for programs being added or removed. Only the
+//background thread touches this until the shell exits and has joined it.
+struct path_watch{
+	//the PATH, and a copy of it split into its directories
+	char *path;
+	char *dirbuf;
+	char **dirs;
+	size_t ndirs;
+
+	//the background thread's own ptrie of the path programs, which `path_vars`
+	//holds snapshots of
+	struct ptrie *index;
+
+	//inotify instance watching the directories, -1 if there is none
+	int fd;
+
+	//a pipe written to when the shell exits, to stop the watching
+	int stop[2];
+
+	//1 once `index` no longer matches the saved index
+	int changed;
+} path_watch = { .fd = -1, .stop = { -1, -1 } };
+
+//the directory events that add or remove a program, and those after which the
+//whole index is read again
+#define MSH_PATH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+#define MSH_PATH_RESCAN (IN_DELETE_SELF | IN_MOVE_SELF | IN_Q_OVERFLOW)
+
+//name of the file, in the cache directory, holding the path programs from the last run
+#define MSH_PATH_CACHE "msh_path_index"
 
-char* difference;
-int count;
+//hashes `len` bytes into `hash` (64-bit FNV-1a)
+static uint64_t stamp_bytes(uint64_t hash, const void *bytes, size_t len){
+	const unsigned char *b = bytes;
+
+	for(size_t i = 0; i < len; i++){
+		hash = (hash ^ b[i]) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+//computes the stamp of the path programs: a hash of the PATH and of the
+//modification time of each of its directories, which changes whenever a
+//program is added to or removed from one of them
+static uint64_t path_stamp(const char *path){
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	char *dirs = strdup(path);
+	char *free_ptr;
+	struct stat st;
+
+	if(dirs == NULL){
+		return 0;
+	}
+	hash = stamp_bytes(hash, path, strlen(path));
+	for(char *dir = strtok_r(dirs, ":", &free_ptr); dir != NULL; dir = strtok_r(NULL, ":", &free_ptr)){
+		if(stat(dir, &st) == 0){
+			hash = stamp_bytes(hash, &st.st_mtim, sizeof(st.st_mtim));
+			hash = stamp_bytes(hash, &st.st_ino, sizeof(st.st_ino));
+		}
+	}
+	free(dirs);
+
+	return hash;
+}
+
+//returns the path of the cache file for the path programs ($XDG_CACHE_HOME, or
+//~/.cache), creating the cache directory if needed, or NULL if there is none
+static char *path_cache_file(void){
+	const char *base = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char dir[PATH_MAX];
+	char *file;
+
+	if(base != NULL && base[0] != '\0'){
+		snprintf(dir, sizeof(dir), "%s", base);
+	} else if(home != NULL && home[0] != '\0'){
+		snprintf(dir, sizeof(dir), "%s/.cache", home);
+	} else{
+		return NULL;
+	}
+	mkdir(dir, 0700);
+
+	file = malloc(strlen(dir) + sizeof("/" MSH_PATH_CACHE));
+	if(file != NULL){
+		sprintf(file, "%s/%s", dir, MSH_PATH_CACHE);
+	}
+	return file;
+}
+
+//the programs found in one path directory, as consecutive NUL-terminated names
+struct path_names{
+	char *buf;
+	size_t len;
+	size_t cap;
+	size_t count;
+};
+
+//the directories of the PATH, handed out to the scanner threads one at a time
+struct path_scan{
+	char **dirs;
+	struct path_names *names;
+	size_t ndirs;
+	atomic_size_t next;
+};
+
+//appends a name to the names of a directory
+static int path_names_add(struct path_names *names, const char *name){
+	size_t len = strlen(name) + 1;
+
+	if(names->len + len > names->cap){
+		size_t cap = names->cap == 0 ? 4096 : names->cap * 2;
+		while(cap < names->len + len){
+			cap *= 2;
+		}
+		char *buf = realloc(names->buf, cap);
+		if(buf == NULL){
+			return -1;
+		}
+		names->buf = buf;
+		names->cap = cap;
+	}
+	memcpy(names->buf + names->len, name, len);
+	names->len += len;
+	names->count++;
+
+	return 0;
+}
+
+//scanner thread: reads the directories not yet taken by another scanner
+static void *path_scanner(void *arg){
+	struct path_scan *scan = arg;
+	size_t i;
+
+	while((i = atomic_fetch_add(&scan->next, 1)) < scan->ndirs){
+		DIR *dr = opendir(scan->dirs[i]);
+		struct dirent *en;
 
-void get_path_vars(){
-	path_vars = ptrie_allocate();
-	DIR *dr;
-	struct dirent *en;
-	char* path = strdup(getenv("PATH"));
-	char* free_ptr;
-	for(char *token1 = strtok_r(path, ":", &free_ptr); token1 != NULL; token1 = __strtok_r(NULL, ":", &free_ptr)){
-		dr = opendir(token1);
 		if(dr){
 			while ((en = readdir(dr)) != NULL) {
-            	ptrie_add(path_vars, en->d_name);
-        	}
+				path_names_add(&scan->names[i], en->d_name);
+			}
+			closedir(dr);
 		}
-		closedir(dr);
 	}
-	free(en);
-	free(path);
+	return NULL;
 }
 
+//reads the programs in all of the directories in `dirs`, scanning up to
+//MSH_MAXSCANNERS directories at once, and adds them to a new ptrie
+static struct ptrie *path_vars_scan(char **dirs, size_t ndirs){
+	struct path_scan scan = { .dirs = dirs, .ndirs = ndirs };
+	pthread_t scanners[MSH_MAXSCANNERS];
+	size_t nscanners = 0;
+	const char **names;
+	size_t nnames = 0;
+	struct ptrie *pt = NULL;
 
+	scan.names = calloc(scan.ndirs + 1, sizeof(struct path_names));
+	if(scan.names == NULL){
+		return NULL;
+	}
+	atomic_init(&scan.next, 0);
 
-void completion(const char *buf, linenoiseCompletions *lc) {
-	if(strcmp(ptrie_autocomplete(past, buf), buf) != 0 && ptrie_autocomplete(past,buf)[0] == *buf){
-		linenoiseAddCompletion(lc, ptrie_autocomplete(past, buf));
+	//scan in parallel, and in this thread as well if no thread could be started
+	while(nscanners < MSH_MAXSCANNERS && nscanners < scan.ndirs &&
+	      pthread_create(&scanners[nscanners], NULL, path_scanner, &scan) == 0){
+		nscanners++;
 	}
-	if(strcmp(ptrie_autocomplete(path_vars, buf), buf) != 0){
-		linenoiseAddCompletion(lc, ptrie_autocomplete(path_vars, buf));
+	path_scanner(&scan);
+	for(size_t i = 0; i < nscanners; i++){
+		pthread_join(scanners[i], NULL);
 	}
-    
-	
+
+	//build the ptrie from all of the names at once
+	for(size_t i = 0; i < scan.ndirs; i++){
+		nnames += scan.names[i].count;
+	}
+	names = malloc((nnames + 1) * sizeof(char *));
+	if(names != NULL){
+		nnames = 0;
+		for(size_t i = 0; i < scan.ndirs; i++){
+			for(size_t off = 0; off < scan.names[i].len; off += strlen(scan.names[i].buf + off) + 1){
+				names[nnames++] = scan.names[i].buf + off;
+			}
+		}
+		pt = ptrie_build_bulk(names, nnames);
+		free(names);
+	}
+	for(size_t i = 0; i < scan.ndirs; i++){
+		free(scan.names[i].buf);
+	}
+	free(scan.names);
+
+	return pt;
 }
 
-char *hints(const char *buf, int *color, int *bold) {
-	*color = 35;
-	*bold = 0;
-	if(buf == NULL || strcmp(buf, "") == 0){
+//splits the PATH into the directories of `path_watch` and starts watching them.
+//This happens before they are read, so that no change is missed in between.
+static int path_watch_init(const char *path){
+	char *free_ptr;
+
+	path_watch.path = strdup(path);
+	path_watch.dirbuf = strdup(path);
+	path_watch.dirs = malloc((strlen(path) / 2 + 1) * sizeof(char *));
+	if(path_watch.path == NULL || path_watch.dirbuf == NULL || path_watch.dirs == NULL){
+		return -1;
+	}
+	for(char *token1 = strtok_r(path_watch.dirbuf, ":", &free_ptr); token1 != NULL; token1 = strtok_r(NULL, ":", &free_ptr)){
+		path_watch.dirs[path_watch.ndirs++] = token1;
+	}
+
+	//without inotify the index simply stays as it was read
+	path_watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	for(size_t i = 0; path_watch.fd != -1 && i < path_watch.ndirs; i++){
+		inotify_add_watch(path_watch.fd, path_watch.dirs[i], MSH_PATH_EVENTS | MSH_PATH_RESCAN | IN_ONLYDIR);
+	}
+
+	return 0;
+}
+
+static void path_vars_watch(void);
+
+//builds the ptrie of the path programs, publishes it in `path_vars`, and then
+//keeps it up to date until the shell exits. It runs on its own thread, so that
+//the prompt does not wait for it.
+static void *get_path_vars(void *arg){
+	const char *env = getenv("PATH");
+	char *cache = path_cache_file();
+	uint64_t stamp;
+	struct ptrie *pt = NULL;
+
+	(void)arg;
+	if(path_watch_init(env == NULL ? "" : env) != 0){
+		free(cache);
 		return NULL;
 	}
-	//try suggesting prev entry
-	char* suggestion = ptrie_autocomplete(past, buf);
-	if(*suggestion != *buf){
+	stamp = path_stamp(path_watch.path);
+
+	//map the index saved by a previous run if none of the directories changed since
+	if(cache != NULL){
+		pt = ptrie_load(cache, stamp);
+	}
+	if(pt == NULL){
+		pt = path_vars_scan(path_watch.dirs, path_watch.ndirs);
+
+		//the path programs rarely change, so compact them for faster lookups
+		//until they do, and save them for the next run
+		if(pt != NULL && cache != NULL){
+			ptrie_save(pt, cache, stamp);
+		}
+		ptrie_freeze(pt);
+	}
+	free(cache);
+	if(pt == NULL){
 		return NULL;
 	}
-	if(strcmp(suggestion, buf) != 0){
-		count = 0;
 
-		//get the difference
-		while(1){
-			if(*(buf + count) != *(suggestion + count)){
-				break;
+	//the ptrie is complete, the callbacks can start using it
+	path_watch.index = pt;
+	ptrie_shared_publish(path_vars, pt);
+	path_vars_watch();
+
+	return NULL;
+}
+
+//sets the count of the program `name` in `pt` to the number of path directories
+//holding it, which is what reading them all again would give
+static void path_vars_sync(struct ptrie *pt, const char *name){
+	char file[PATH_MAX];
+	struct stat st;
+	unsigned int want = 0;
+	unsigned int have = ptrie_count(pt, name);
+
+	for(size_t i = 0; i < path_watch.ndirs; i++){
+		snprintf(file, sizeof(file), "%s/%s", path_watch.dirs[i], name);
+		if(lstat(file, &st) == 0){
+			want++;
+		}
+	}
+
+	//names the ptrie cannot hold fail to be added, so stop on failure
+	while(have < want && ptrie_add(pt, name) == 0){
+		have++;
+	}
+	while(have > want && ptrie_remove(pt, name) == 0){
+		have--;
+	}
+}
+
+//applies the changes made to the path directories since the last call,
+//without waiting for any, and publishes them
+static void path_vars_update(void){
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	int rescan = 0;
+	int changed = 0;
+	ssize_t len;
+
+	while((len = read(path_watch.fd, buf, sizeof(buf))) > 0){
+		for(char *ev = buf; ev < buf + len; ev += sizeof(struct inotify_event) + ((struct inotify_event *)ev)->len){
+			struct inotify_event *event = (struct inotify_event *)ev;
+
+			if(event->mask & MSH_PATH_RESCAN){
+				rescan = 1;
+			} else if((event->mask & MSH_PATH_EVENTS) && event->len > 0 && !rescan){
+				path_vars_sync(path_watch.index, event->name);
 			}
-			count++;
+			changed = 1;
 		}
-		strncpy(difference, suggestion + count, strlen(suggestion));
-    	return difference;
 	}
 
-	//else try suggesting a path variable
-	char* suggestion2 = ptrie_autocomplete(path_vars, buf);
-	if(strcmp(suggestion2, buf) != 0){
-		count = 0;
+	//events were lost, or a whole directory went away: read everything again
+	if(rescan){
+		struct ptrie *fresh = path_vars_scan(path_watch.dirs, path_watch.ndirs);
+
+		if(fresh != NULL){
+			ptrie_free(path_watch.index);
+			path_watch.index = fresh;
+		}
+	}
+
+	//a batch of events usually comes from a single install, so publish once for all of them
+	if(changed){
+		ptrie_shared_publish(path_vars, path_watch.index);
+		path_watch.changed = 1;
+	}
+}
+
+//waits for changes to the path directories and applies them, until the shell
+//writes to the stop pipe
+static void path_vars_watch(void){
+	struct pollfd fds[2] = {
+		{ .fd = path_watch.fd, .events = POLLIN },
+		{ .fd = path_watch.stop[0], .events = POLLIN },
+	};
 
-		//get the difference
-		while(1){
-			if(*(buf + count) != *(suggestion2 + count)){
+	if(path_watch.fd == -1 || path_watch.stop[0] == -1){
+		return;
+	}
+	while(1){
+		if(poll(fds, 2, -1) < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			return;
+		}
+
+		//the changes made until the shell exits still go into the saved index
+		if(fds[1].revents != 0){
+			path_vars_update();
+			return;
+		}
+		if(fds[0].revents != 0){
+			path_vars_update();
+		}
+	}
+}
+
+//the memory budget of the past entries, from the environment or the default
+static size_t history_budget(void){
+	const char *env = getenv("MSH_HISTORY_BUDGET");
+	char *end;
+	unsigned long long budget;
+
+	if(env == NULL || env[0] == '\0'){
+		return MSH_HISTORY_BUDGET;
+	}
+	budget = strtoull(env, &end, 10);
+	if(*end != '\0'){
+		return MSH_HISTORY_BUDGET;
+	}
+	return budget;
+}
+
+//starts building the path programs in the background. The thread blocks the
+//signals the shell handles, so that they are delivered to the main thread.
+static void start_path_vars(void){
+	sigset_t all, old;
+
+	path_vars = ptrie_shared_allocate();
+	if(path_vars == NULL){
+		return;
+	}
+	path_vars_reader = ptrie_shared_register(path_vars);
+	if(pipe(path_watch.stop) != 0){
+		path_watch.stop[0] = path_watch.stop[1] = -1;
+	} else{
+		fcntl(path_watch.stop[0], F_SETFD, FD_CLOEXEC);
+		fcntl(path_watch.stop[1], F_SETFD, FD_CLOEXEC);
+	}
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	if(pthread_create(&path_vars_thread, NULL, get_path_vars, NULL) != 0){
+		//without a thread, build it right away, and do not keep it up to date
+		if(path_watch.stop[0] != -1){
+			close(path_watch.stop[0]);
+			close(path_watch.stop[1]);
+			path_watch.stop[0] = path_watch.stop[1] = -1;
+		}
+		path_vars_thread = pthread_self();
+		get_path_vars(NULL);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+//adds the completions in `cands` that are not the buffer itself and were not already offered
+static void add_completions(const char *buf, linenoiseCompletions *lc, const char **cands, size_t n){
+	for(size_t i = 0; i < n; i++){
+		int dup = strcmp(cands[i], buf) == 0;
+
+		for(size_t j = 0; j < lc->len && !dup; j++){
+			dup = strcmp(lc->cvec[j], cands[i]) == 0;
+		}
+		if(!dup){
+			linenoiseAddCompletion(lc, cands[i]);
+		}
+	}
+}
+
+static void fuzzy_visit(const char *str, unsigned int count, void *arg){
+	(void)count;
+	fuzzy_add(arg, str);
+}
+
+//copies the past entries and the path programs in `pv` into `fuzzy_index`
+//again if the path programs changed since the last time
+static void fuzzy_refresh(struct ptrie *pv){
+	uint64_t path_version = pv == NULL ? 0 : ptrie_version(pv);
+
+	if(path_version == fuzzy_path_version){
+		return;
+	}
+	fuzzy_clear(fuzzy_index);
+	ptrie_walk(past, fuzzy_visit, fuzzy_index);
+	if(pv != NULL){
+		ptrie_walk(pv, fuzzy_visit, fuzzy_index);
+	}
+	fuzzy_path_version = path_version;
+}
+
+//adds a line to the past entries, to the fuzzy candidates if it is new, and to
+//the searched entries with its new rank
+static void past_add(const char *str){
+	if(ptrie_add(past, str) != 0){
+		return;
+	}
+	if(fuzzy_index != NULL && ptrie_count(past, str) == 1){
+		fuzzy_add(fuzzy_index, str);
+	}
+	if(history_index != NULL){
+		ngram_add(history_index, str, ptrie_rank(past, str));
+	}
+}
+
+//drops a past entry from the fuzzy candidates and the searched entries once
+//`past` evicts it
+static void past_evicted(const char *str, void *arg){
+	(void)arg;
+	if(fuzzy_index != NULL){
+		fuzzy_remove(fuzzy_index, str);
+	}
+	if(history_index != NULL){
+		ngram_remove(history_index, str);
+	}
+}
+
+//completes the word being typed from the arguments given at the same position
+//to the same program before, so that `git ch` offers `git checkout`
+static void arg_completions(const char *buf, linenoiseCompletions *lc){
+	const char *cands[MSH_MAXCOMPLETIONS];
+	char *lines[MSH_MAXCOMPLETIONS];
+	struct msh_sequence *s = args_seq;
+	struct msh_pipeline *p, *last = NULL;
+	struct msh_command *c = NULL, *cmd;
+	const char *seg = buf;
+	size_t len = strlen(buf), nargs = 0, pos;
+	char **args;
+
+	//the command being typed is after the last pipe or semicolon, and must have
+	//its program already
+	for(const char *ch = buf; *ch != '\0'; ch++){
+		if(*ch == '|' || *ch == ';') seg = ch + 1;
+	}
+	if(args_index == NULL || s == NULL || seg[strspn(seg, " ")] == '\0'){
+		return;
+	}
+
+	if(msh_sequence_parse((char *)buf, s) == 0){
+		while((p = msh_sequence_pipeline(s)) != NULL){
+			if(last != NULL) msh_pipeline_free(last);
+			last = p;
+		}
+	}
+	for(size_t i = 0; last != NULL && (cmd = msh_pipeline_command(last, i)) != NULL; i++){
+		c = cmd;
+	}
+	args = msh_command_args(c);
+	while(args != NULL && args[nargs] != NULL){
+		nargs++;
+	}
+
+	//a trailing space starts the next argument, else the last one is being typed,
+	//unless the buffer ends with something that is not an argument, like `&`
+	pos = buf[len - 1] == ' ' ? nargs : nargs - 1;
+	if(nargs > 0 && pos > 0 && strlen(args[nargs - 1]) <= len
+	   && (pos == nargs || strcmp(buf + len - strlen(args[pos]), args[pos]) == 0)){
+		const char *word = pos == nargs ? "" : args[pos];
+		size_t base = len - strlen(word);
+		size_t n;
+
+		n = argtrie_topk(args_index, msh_command_program(c), pos, word, MSH_MAXCOMPLETIONS, cands);
+		for(size_t i = 0; i < n; i++){
+			lines[i] = malloc(base + strlen(cands[i]) + 1);
+			if(lines[i] == NULL){
+				n = i;
 				break;
 			}
-			count++;
+			memcpy(lines[i], buf, base);
+			strcpy(lines[i] + base, cands[i]);
 		}
-		strncpy(difference, suggestion2 + count, strlen(suggestion2));
-    	return difference;
+		add_completions(buf, lc, (const char **)lines, n);
+		for(size_t i = 0; i < n; i++){
+			free(lines[i]);
+		}
+	}
+	if(last != NULL){
+		msh_pipeline_free(last);
 	}
+	msh_sequence_reset(s);
+}
 
-	return NULL;
+void completion(const char *buf, linenoiseCompletions *lc) {
+	const char *cands[MSH_MAXCOMPLETIONS];
+	size_t n;
 
-	
+	struct ptrie *pv = NULL;
+
+	//while searching, offer only the past entries holding what follows the key
+	if(buf[0] == MSH_SEARCH_KEY){
+		if(history_index != NULL){
+			n = ngram_search(history_index, buf + 1, MSH_MAXCOMPLETIONS, cands);
+			add_completions(buf, lc, cands, n);
+		}
+		return;
+	}
+
+	//offer the arguments usually given to the program first, then the most frequent
+	//past entries, then the programs in the path once they have been read. The
+	//completions are copied before leaving the snapshot.
+	arg_completions(buf, lc);
+	if(path_vars_reader != -1){
+		pv = ptrie_shared_enter(path_vars, path_vars_reader);
+	}
+	n = ptrie_topk(past, buf, MSH_MAXCOMPLETIONS, cands);
+	add_completions(buf, lc, cands, n);
+	if(pv != NULL){
+		n = ptrie_topk(pv, buf, MSH_MAXCOMPLETIONS, cands);
+		add_completions(buf, lc, cands, n);
+	}
+
+	//then those that hold the typed characters in order, anywhere in them
+	if(fuzzy_index != NULL){
+		fuzzy_refresh(pv);
+		n = fuzzy_match(fuzzy_index, buf, MSH_MAXCOMPLETIONS, cands);
+		add_completions(buf, lc, cands, n);
+	}
+	if(path_vars_reader != -1){
+		ptrie_shared_exit(path_vars, path_vars_reader);
+	}
 }
 
+char *hints(const char *buf, int *color, int *bold) {
+	const char *suggestion;
+	size_t len;
+
+	*color = 35;
+	*bold = 0;
+	if(buf == NULL || strcmp(buf, "") == 0){
+		return NULL;
+	}
+	len = strlen(buf);
 
+	//while searching, show the past entry that would run
+	if(buf[0] == MSH_SEARCH_KEY){
+		if(history_index == NULL || ngram_search(history_index, buf + 1, 1, &suggestion) == 0){
+			return NULL;
+		}
+		snprintf(search_hint, sizeof(search_hint), "  (reverse-i-search): %s", suggestion);
+		return search_hint;
+	}
 
+	//try suggesting prev entry, else try suggesting a path variable once they have been read
+	suggestion = ptrie_cursor_lookup(past_cursor, past, buf);
+	if((suggestion == NULL || suggestion[len] == '\0') && path_vars_reader != -1){
+		struct ptrie *pv = ptrie_shared_enter(path_vars, path_vars_reader);
+
+		suggestion = pv == NULL ? NULL : ptrie_cursor_lookup(path_cursor, pv, buf);
+		if(suggestion != NULL){
+			snprintf(path_hint, sizeof(path_hint), "%s", suggestion);
+			suggestion = path_hint;
+		}
+		ptrie_shared_exit(path_vars, path_vars_reader);
+	}
+	if(suggestion == NULL || suggestion[len] == '\0'){
+		return NULL;
+	}
+
+	//the suggestion starts with the buffer, so the hint is the rest of it. It is
+	//borrowed from the ptrie, and linenoise only reads it before the next add.
+	return (char *)suggestion + len;
+}
+
+//replaces a search line with a copy of the best past entry holding what follows the
+//key, or frees it and returns NULL when there is none
+static char *search_accept(char *line){
+	const char *match;
+	char *copy = NULL;
+
+	if(history_index != NULL && ngram_search(history_index, line + 1, 1, &match) == 1){
+		copy = strdup(match);
+	} else{
+		fprintf(stderr, "msh: no past entry holds \"%s\"\n", line + 1);
+	}
+	free(line);
+
+	return copy;
+}
+
+//whether `arg` redirects the output, so that it and the file after it are not arguments
+static int is_redirection(const char *arg){
+	return strcmp(arg, "1>") == 0 || strcmp(arg, "1>>") == 0 || strcmp(arg, "2>") == 0 || strcmp(arg, "2>>") == 0;
+}
+
+//learns the arguments of every command in `p`, before running it frees them. Only
+//those before a redirection are learned, the ones the program is run with.
+static void learn_args(struct msh_pipeline *p){
+	struct msh_command *c;
+
+	for(size_t i = 0; args_index != NULL && (c = msh_pipeline_command(p, i)) != NULL; i++){
+		char **args = msh_command_args(c);
+		size_t n = 0;
+
+		while(args[n] != NULL && !is_redirection(args[n])){
+			n++;
+		}
+		//cut the list there for as long as it is learned
+		char *redir = args[n];
+		args[n] = NULL;
+		argtrie_add(args_index, args);
+		args[n] = redir;
+	}
+}
 
-	
-	
 char *msh_input(void){
+	/* You can change this displayed string to whatever you'd like ;-) */
+	const char *prompt = "(ネン) > ";
 	char *line;
 
-	/* You can change this displayed string to whatever you'd like ;-) */
-	line = linenoise("(ネン) > ");
+	line = linenoise(prompt);
+	/* a search runs its best match, and asks again when nothing matches */
+	while (line && line[0] == MSH_SEARCH_KEY) {
+		line = search_accept(line);
+		if (line == NULL) line = linenoise(prompt);
+	}
 	if (line && strlen(line) == 0) {
 		free(line);
 
@@ -125,8 +757,23 @@ int main(int argc, char *argv[]){
 		return EXIT_FAILURE;
 	}
 	past = ptrie_allocate();
-	get_path_vars();
-	difference = malloc(128);
+	if(past != NULL){
+		//suggest what was run often lately over what was run often long ago
+		ptrie_set_halflife(past, MSH_HISTORY_HALFLIFE);
+		ptrie_set_budget(past, history_budget());
+		ptrie_set_evicted(past, past_evicted, NULL);
+	}
+	past_cursor = ptrie_cursor_allocate();
+	path_cursor = ptrie_cursor_allocate();
+	fuzzy_index = fuzzy_allocate();
+	history_index = ngram_allocate();
+	args_index = argtrie_allocate();
+	args_seq = msh_sequence_alloc();
+	if(args_index != NULL){
+		argtrie_set_budget(args_index, MSH_ARGS_BUDGET);
+		argtrie_set_max_programs(args_index, MSH_ARGS_PROGRAMS);
+	}
+	start_path_vars();
 
 	/*
 	 * See `ln/README.markdown` for linenoise usage. If you don't
@@ -139,14 +786,16 @@ int main(int argc, char *argv[]){
 
 	
 
+	/* one sequence for every line, reset after each so its memory is reused */
+	s = msh_sequence_alloc();
+	if (s == NULL) {
+		printf("MSH Error: Could not allocate msh sequence at initialization\n");
+		return EXIT_FAILURE;
+	}
+
 	/* Lets keep getting inputs! */
 	while (1){
 		fflush(stdout);
-		s = msh_sequence_alloc();
-		if (s == NULL) {
-			printf("MSH Error: Could not allocate msh sequence at initialization\n");
-			return EXIT_FAILURE;
-		}
 		char *str;
 		struct msh_pipeline *p;
 		msh_err_t err;
@@ -158,36 +807,76 @@ int main(int argc, char *argv[]){
 		} /* you must maintain this behavior: an empty command exits */
 	
 		err = msh_sequence_parse(str, s);
-		ptrie_add(past, str);
+		past_add(str);
+		/* a line that does not parse runs none of its pipelines, but the shell goes on */
 		if (err != 0) {
 			printf("MSH Error: %s\n", msh_pipeline_err2str(err));
-
-			return err;
+			free(str);
+			msh_sequence_reset(s);
+			continue;
 		}
 		
 		
 		/* dequeue pipelines and sequentially execute them */
 		while ((p = msh_sequence_pipeline(s)) != NULL) {
+			learn_args(p);
 			msh_execute(p);	
 			
 		}
 		//i++;
 		free(str);
-		msh_sequence_free(s);
-		s = NULL;
-	}
-	//frees
-	if(s != NULL){
-		msh_sequence_free(s);
+		msh_sequence_reset(s);
 	}
+	//frees, with the background pipelines that are still running
+	msh_execute(NULL);
+	msh_sequence_free(s);
+	msh_sequence_free(args_seq);
 
 	if(past != NULL){
 		ptrie_free(past);
 	}
+	ptrie_cursor_free(past_cursor);
+	ptrie_cursor_free(path_cursor);
+	fuzzy_free(fuzzy_index);
+	ngram_free(history_index);
+	argtrie_free(args_index);
 
+	//stop watching the path programs, and wait for them in case they are still
+	//being read. The stamp is taken before the last changes are applied, so that
+	//a change missed here makes the stamp stale rather than the index.
 	if(path_vars != NULL){
-		ptrie_free(path_vars);
+		const char *env = getenv("PATH");
+		uint64_t stamp = path_stamp(env == NULL ? "" : env);
+
+		if(path_watch.stop[1] != -1){
+			write(path_watch.stop[1], "", 1);
+		}
+		if(!pthread_equal(path_vars_thread, pthread_self())){
+			pthread_join(path_vars_thread, NULL);
+		}
+
+		//if programs were added or removed, save the updated index for the next run
+		if(path_watch.index != NULL){
+			char *cache = path_cache_file();
+
+			if(path_watch.changed && cache != NULL){
+				ptrie_save(path_watch.index, cache, stamp);
+			}
+			free(cache);
+			ptrie_free(path_watch.index);
+		}
+		ptrie_shared_free(path_vars);
+	}
+	if(path_watch.fd != -1){
+		close(path_watch.fd);
+	}
+	if(path_watch.stop[0] != -1){
+		close(path_watch.stop[0]);
+		close(path_watch.stop[1]);
 	}
+	free(path_watch.path);
+	free(path_watch.dirbuf);
+	free(path_watch.dirs);
 
 	
 
@@ -1,70 +1,239 @@
 #include <msh.h>
 #include <msh_parse.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
-/* Maximum number of background pipelines */
-#define MSH_MAXBACKGROUND 16
-/* each command can have MSH_MAXARGS or fewer arguments */
-#define MSH_MAXARGS  16
-/* each pipeline has MSH_MAXCMNDS or fewer commands */
-#define MSH_MAXCMNDS 16
+/* arguments, with the NULL after them, held in the command before they are allocated */
+#define MSH_ARGS_INLINE 8
+/* pipelines held in the sequence before they are allocated, a power of two */
+#define MSH_PIPELINES_INLINE 4
+/* freed pipelines are pooled by commands, 1, 2, 4... up to 1 << (MSH_POOL_PIPELINES - 2),
+ * and any more than that in the last class */
+#define MSH_POOL_PIPELINES 6
+/* freed lines are pooled by bytes, 64, 128... up to 64 << (MSH_POOL_LINES - 1) */
+#define MSH_POOL_LINES 12
+/* each size class keeps MSH_POOL_DEPTH or fewer of them, or as many pipelines as
+ * the last line parsed had in it */
+#define MSH_POOL_DEPTH 16
 
 
 struct msh_command{
 	//boolean value if the command is the last in the pipeline
 	int last_cmd;
 
-	//an array of strings for the args
-	char* args[MSH_MAXARGS];
+	//a NULL-terminated array of strings for the args, in `args_inline` until it
+	//outgrows it, and how many it has room for
+	char** args;
+	unsigned int args_cap;
 
 	//how many args we have 
 	unsigned int args_count;
 
+	char* args_inline[MSH_ARGS_INLINE];
+
 	struct proc_data* p_data;
 
 };
 
+//one parsed line, shared by the pipelines parsed from it, which hold a reference
+//each: the words of their commands, then their text
+struct msh_line{
+	unsigned int refs;
+
+	//the bytes in `text`, and the next free line while it is pooled
+	size_t cap;
+	struct msh_line* next;
+
+	char text[];
+};
+
 struct msh_pipeline{
 	//boolean value if the pipeline is running in the foreground or the background
 	int background;
 
-	//a string that holds the parsed pipeline
+	//a string that holds the parsed pipeline, in `line`
 	char* parsed_cmd;
 
+	//the line the pipeline was parsed from, which holds its text and arguments
+	struct msh_line* line;
+
 	//the file directory if we have to redirect to a file
 	int open_fd;
 
 	//the std we redirect from
 	int redirect;
 
-	//an array of commands
-	struct msh_command* commands[MSH_MAXCMNDS];
-
 	//count of the commands
 	unsigned int cmd_count;
 
 	//index counter for inserting new indices
 	unsigned int cmd_index;
+
+	//the next free pipeline while it is pooled
+	struct msh_pipeline* next;
+
+	//the commands, allocated with the pipeline, at least as many as it has pipes plus one
+	unsigned int cmd_alloc;
+	struct msh_command commands[];
 };
 
 struct msh_sequence{
-	//an array of pipelines
-	struct msh_pipeline* pipelines[MSH_MAXBACKGROUND];
+	//a ring buffer of pipelines, allocated as they are parsed, in `pipelines_inline`
+	//until it outgrows it, and how many it has room for, a power of two
+	struct msh_pipeline** pipelines;
+	unsigned int pl_cap;
 
-	//a count of pipelines
+	//where the first pipeline in the queue is, and how many are queued
+	unsigned int pl_head;
 	unsigned int pl_count;
 
-	//index counter for inserting new pipelines
-	unsigned int pl_index;
+	struct msh_pipeline* pipelines_inline[MSH_PIPELINES_INLINE];
 };
 
 
+//how many allocations the parser made, see `msh_parse_allocations`
+static size_t msh_allocs;
+
+//allocates for the parser, counting the allocations
+static void *msh_malloc(size_t size){
+	msh_allocs++;
+	return malloc(size);
+}
+
+static void *msh_calloc(size_t n, size_t size){
+	msh_allocs++;
+	return calloc(n, size);
+}
+
+//grows `arr`, an array of `*cap` pointers held in `inline_arr` at first, to twice
+//as many with the new ones NULL, and returns it, or NULL if it could not
+static void *msh_grow(void *arr, unsigned int *cap, void *inline_arr){
+	char *grown;
+	size_t size = *cap * sizeof(void *);
+
+	if(arr == inline_arr){
+		grown = msh_malloc(2 * size);
+		if(grown != NULL){
+			memcpy(grown, inline_arr, size);
+		}
+	} else{
+		msh_allocs++;
+		grown = realloc(arr, 2 * size);
+	}
+	if(grown == NULL){
+		return NULL;
+	}
+	memset(grown + size, 0, size);
+	*cap *= 2;
+
+	return grown;
+}
+
+//the slot of the `nth` pipeline in the queue, one past the last is where the next goes
+static struct msh_pipeline **msh_sequence_slot(struct msh_sequence *s, unsigned int nth){
+	return &s->pipelines[(s->pl_head + nth) & (s->pl_cap - 1)];
+}
+
+//doubles the room for pipelines of a full sequence
+static int msh_sequence_grow(struct msh_sequence *s){
+	unsigned int cap = s->pl_cap;
+	struct msh_pipeline **pipelines = msh_grow(s->pipelines, &s->pl_cap, s->pipelines_inline);
+
+	if(pipelines == NULL){
+		return -1;
+	}
+	//the queue wraps around to the start, move that part past the old end so
+	//that it follows on from the rest
+	memcpy(pipelines + cap, pipelines, s->pl_head * sizeof(*pipelines));
+	memset(pipelines, 0, s->pl_head * sizeof(*pipelines));
+	s->pipelines = pipelines;
+
+	return 0;
+}
 
-//frees an individual command
+size_t msh_parse_allocations(void){
+	return msh_allocs;
+}
+
+//freed pipelines and lines kept for the next lines to reuse, by size class
+static struct{
+	struct msh_pipeline* pipelines[MSH_POOL_PIPELINES];
+	unsigned int npipelines[MSH_POOL_PIPELINES];
+	struct msh_line* lines[MSH_POOL_LINES];
+	unsigned int nlines[MSH_POOL_LINES];
+
+	//how many pipelines of each class the last line parsed had
+	unsigned int parsed[MSH_POOL_PIPELINES];
+} msh_pool;
+
+//the smallest class holding `n`, with classes doubling from `min`, or `classes`
+//if `n` is too big to be pooled
+static unsigned int msh_size_class(size_t n, size_t min, unsigned int classes){
+	unsigned int class = 0;
+
+	while(class < classes && (min << class) < n){
+		class++;
+	}
+	return class;
+}
+
+//the class of pipelines with room for `ncmds` commands, the last one holds those
+//with more than the others
+static unsigned int msh_pipeline_class(unsigned int ncmds){
+	return msh_size_class(ncmds, 1, MSH_POOL_PIPELINES - 1);
+}
+
+//how many freed pipelines of `class` are pooled, enough for the last line again
+static unsigned int msh_pool_depth(unsigned int class){
+	return msh_pool.parsed[class] > MSH_POOL_DEPTH ? msh_pool.parsed[class] : MSH_POOL_DEPTH;
+}
+
+//gets a line of at least `size` bytes, from the pool if one is there
+static struct msh_line *msh_line_get(size_t size){
+	unsigned int class = msh_size_class(size, 64, MSH_POOL_LINES);
+	struct msh_line *line;
+
+	if(class < MSH_POOL_LINES && msh_pool.lines[class] != NULL){
+		line = msh_pool.lines[class];
+		msh_pool.lines[class] = line->next;
+		msh_pool.nlines[class]--;
+	} else{
+		size_t cap = class < MSH_POOL_LINES ? (size_t)64 << class : size;
+
+		line = msh_malloc(sizeof(struct msh_line) + cap);
+		if(line == NULL){
+			return NULL;
+		}
+		line->cap = cap;
+	}
+	line->refs = 1;
+
+	return line;
+}
+
+//drops a pipeline's reference to its line, pooling the line after the last one
+static void msh_line_put(struct msh_line *line){
+	if(line == NULL || --line->refs != 0){
+		return;
+	}
+
+	unsigned int class = msh_size_class(line->cap, 64, MSH_POOL_LINES);
+	if(class < MSH_POOL_LINES && msh_pool.nlines[class] < MSH_POOL_DEPTH){
+		line->next = msh_pool.lines[class];
+		msh_pool.lines[class] = line;
+		msh_pool.nlines[class]++;
+	} else{
+		free(line);
+	}
+}
+
+//frees an individual command's data, and empties it for the next line. The args
+//point into the pipeline's line, which frees them, and their array is kept, along
+//with the room it grew to.
 static void msh_command_free(struct msh_command* c){
 	//if the command is null, there's nothing to free
 	if(c == NULL){
@@ -72,24 +241,20 @@ static void msh_command_free(struct msh_command* c){
 	}
 	if(c->p_data != NULL){
 		free(c->p_data);
+		c->p_data = NULL;
 	}
+	c->args_count = 0;
+	c->last_cmd = 0;
+}
 
-	//iterates through each args, frees the args if possible
-	for(unsigned int i = 0; i < MSH_MAXARGS; i++){
-		//check if the args is null
-		if(c->args[i] != NULL){
-			//free the args
-			free(c->args[i]);
+//frees a pipeline for good, with the args arrays its commands grew
+static void msh_pipeline_destroy(struct msh_pipeline *p){
+	for(unsigned int i = 0; i < p->cmd_alloc; i++){
+		if(p->commands[i].args != p->commands[i].args_inline){
+			free(p->commands[i].args);
 		}
-		
-
-		//sets the free'd args to null
-		c->args[i] = NULL;
 	}
-
-	//sets the command to null when everything in the command is freed
-	c = NULL;
-	return;
+	free(p);
 }
 
 //frees an individual pipeline
@@ -99,30 +264,25 @@ void msh_pipeline_free(struct msh_pipeline *p){
 		return;
 	}
 
-	//free the parsed pipeline
-	if(p->parsed_cmd != NULL){
-		free(p->parsed_cmd);
-		p->parsed_cmd = NULL;
-	}
-
-	//iterates through each command
-	for(unsigned int i = 0; i < MSH_MAXCMNDS; i++){
-
-		//commands are queued, so if we run into null command, the subsequent commands are also null
-		if(p->commands[i] == NULL){
-			break;
-		}
+	//free the parsed pipeline and its arguments, unless other pipelines still use them
+	msh_line_put(p->line);
+	p->line = NULL;
+	p->parsed_cmd = NULL;
 
-		//free the commands
-		if(p->commands[i] != NULL){
-			msh_command_free(p->commands[i]);
-			free(p->commands[i]);
-			p->commands[i] = NULL;
-		}
+	//free each command's data, the commands themselves are part of the pipeline
+	for(unsigned int i = 0; i < p->cmd_alloc; i++){
+		msh_command_free(&p->commands[i]);
 	}
 
-	//set the pipeline to null
-	free(p);
+	//pool the pipeline for the next line, unless there are enough of its size
+	unsigned int class = msh_pipeline_class(p->cmd_alloc);
+	if(msh_pool.npipelines[class] < msh_pool_depth(class)){
+		p->next = msh_pool.pipelines[class];
+		msh_pool.pipelines[class] = p;
+		msh_pool.npipelines[class]++;
+	} else{
+		msh_pipeline_destroy(p);
+	}
 	p = NULL;
 }
 
@@ -135,66 +295,99 @@ void msh_sequence_free(struct msh_sequence *s){
 		return;
 	}
 
+	//free each pipeline
+	msh_sequence_reset(s);
+
+	//free the sequence
+	if(s->pipelines != s->pipelines_inline){
+		free(s->pipelines);
+	}
+	free(s);
+}
+
+//empties a sequence for the next line
+void msh_sequence_reset(struct msh_sequence *s){
 	//iterates through and free each pipeline
-	for(unsigned int i = 0; i < MSH_MAXBACKGROUND; i++){
+	for(unsigned int i = 0; i < s->pl_cap; i++){
 
 		//check if the pipeline is null
 		if(s->pipelines[i] != NULL){
 			msh_pipeline_free(s->pipelines[i]);
+			s->pipelines[i] = NULL;
 		}
 	}
 
-	//free the sequence
-	free(s);
+	//reset the queue
+	s->pl_head = 0;
+	s->pl_count = 0;
 }
 
-//allocates one command
-struct msh_command* msh_command_alloc(){
-
-	//calloc one command
-	struct msh_command* command = calloc(1, sizeof(struct msh_command));
+//allocates one pipeline with at least `ncmds` commands, reusing a pooled one if it can
+static struct msh_pipeline* msh_pipeline_alloc(unsigned int ncmds){
+	unsigned int class = msh_pipeline_class(ncmds);
+	struct msh_pipeline* pipeline;
+	struct msh_pipeline** best = NULL;
 
-	//if calloc failed
-	if(command == NULL){
-		return NULL;
+	//round up to the size class, so that the pipeline can be pooled once freed
+	if(class < MSH_POOL_PIPELINES - 1){
+		ncmds = 1u << class;
 	}
-	
-	//intialize the defaults values
-	command->args_count = 0;
-	command->last_cmd = 0;
-
-	//return the command
-	return command;
-}
 
-//allocates one pipeline
-static struct msh_pipeline* msh_pipeline_alloc(){
+	//the last class holds pipelines of any size, take the smallest with enough
+	//commands, the others hold only the one size
+	for(struct msh_pipeline** next = &msh_pool.pipelines[class]; *next != NULL; next = &(*next)->next){
+		if((*next)->cmd_alloc >= ncmds && (best == NULL || (*next)->cmd_alloc < (*best)->cmd_alloc)){
+			best = next;
+			if((*best)->cmd_alloc == ncmds){
+				break;
+			}
+		}
+	}
 
-	//callocs the size of one pipeline
-	struct msh_pipeline* pipeline = calloc(1, sizeof(struct msh_pipeline));
+	//takes a pooled pipeline and clears all but its commands, which were emptied as
+	//it was freed, or callocs the pipeline and its commands at once
+	if(best != NULL){
+		pipeline = *best;
+		*best = pipeline->next;
+		msh_pool.npipelines[class]--;
+		ncmds = pipeline->cmd_alloc;
+		memset(pipeline, 0, offsetof(struct msh_pipeline, commands));
+	} else{
+		pipeline = msh_calloc(1, sizeof(struct msh_pipeline) + ncmds * sizeof(struct msh_command));
+	}
 
 	//if calloc failed
 	if(pipeline == NULL){
 		return NULL;
 	}
 
-	//calloc each command in the array of commands
-	for(unsigned int i = 0; i < MSH_MAXCMNDS; i++){
-		pipeline->commands[i] = msh_command_alloc();
-	}
-
 	//intialize the counts
 	pipeline->cmd_count = 0;
 	pipeline->cmd_index = 0;
+	pipeline->cmd_alloc = ncmds;
 
 	//return the pipeline
 	return pipeline;
 }
 
-//allocs an individual sequence
+//sizes the pool to the line just parsed, which had `parsed` pipelines of each class
+static void msh_pool_resize(unsigned int parsed[MSH_POOL_PIPELINES]){
+	for(unsigned int class = 0; class < MSH_POOL_PIPELINES; class++){
+		msh_pool.parsed[class] = parsed[class];
+		while(msh_pool.npipelines[class] > msh_pool_depth(class)){
+			struct msh_pipeline* p = msh_pool.pipelines[class];
+
+			msh_pool.pipelines[class] = p->next;
+			msh_pool.npipelines[class]--;
+			msh_pipeline_destroy(p);
+		}
+	}
+}
+
+//allocs an individual sequence, its pipelines are allocated as they are parsed
 struct msh_sequence *msh_sequence_alloc(void){
 	//calloc a sequence
-	struct msh_sequence* sequence = calloc(1, sizeof(struct msh_sequence));
+	struct msh_sequence* sequence = msh_calloc(1, sizeof(struct msh_sequence));
 
 	//if sequence callocing failed, return
 	if(sequence == NULL){
@@ -202,16 +395,10 @@ struct msh_sequence *msh_sequence_alloc(void){
 	}
 
 	//intialize the default values
+	sequence->pl_head = 0;
 	sequence->pl_count = 0;
-	sequence->pl_index = 0;
-
-	//allocates each pipeline in the pipeline alloc
-	for(unsigned int i = 0; i < MSH_MAXBACKGROUND; i++){
-		sequence->pipelines[i] = msh_pipeline_alloc();
-		if(sequence->pipelines[i] == NULL){
-			return NULL;
-		}
-	}
+	sequence->pipelines = sequence->pipelines_inline;
+	sequence->pl_cap = MSH_PIPELINES_INLINE;
 
 	//return the sequence
 	return sequence;
@@ -223,150 +410,222 @@ char *msh_pipeline_input(struct msh_pipeline *p){
 }
 
 
-//parses the sequence
-msh_err_t msh_sequence_parse(char *str, struct msh_sequence *seq){
-	if(str == NULL || seq == NULL || strcmp(str, "") == 0){
-		return MSH_ERR_PIPE_MISSING_CMD;
-	}
-	//strdup the str so we can mutilate the str args
-	char* tokenRest = strdup(str);
+//the kinds of tokens of a line
+enum msh_token{
+	MSH_TOKEN_END,
+	MSH_TOKEN_SEMI,
+	MSH_TOKEN_PIPE,
+	MSH_TOKEN_AMP,
+	MSH_TOKEN_REDIR,
+	MSH_TOKEN_WORD
+};
 
-	//store the pointer so we can free it later (strdup mallocs space)
-	char* free_ptr = tokenRest;
+//the redirections, shared by every command that uses them
+static char msh_redir_out[] = "1>", msh_redir_out_append[] = "1>>";
+static char msh_redir_err[] = "2>", msh_redir_err_append[] = "2>>";
 
+//reads the token at `*pos` and moves past it. A word is copied to `*words` and
+//NUL-terminated there, and `*tok` points to it, or to the redirection.
+static enum msh_token msh_lex(const char **pos, char **words, char **tok){
+	const char *c = *pos;
 
-	//parses the sequence into pipelines
-	for(char *token1 = strtok_r(tokenRest, ";", &tokenRest); token1 != NULL; token1 = __strtok_r(NULL, ";", &tokenRest)){
+	while(*c == ' ' || *c == '\t'){
+		c++;
+	}
+	*pos = c + 1;
+	switch(*c){
+	case '\0':
+		*pos = c;
+		return MSH_TOKEN_END;
+	case ';':
+		return MSH_TOKEN_SEMI;
+	case '|':
+		return MSH_TOKEN_PIPE;
+	case '&':
+		return MSH_TOKEN_AMP;
+	}
 
-		//allocates space for the parsed pipeline string
-		if(seq->pipelines[seq->pl_index]->parsed_cmd == NULL){
-			seq->pipelines[seq->pl_index]->parsed_cmd = malloc(256);
-		}
+	//`1>`, `2>`, and `>` for `1>`, with another `>` to append
+	if(*c == '>' || ((*c == '1' || *c == '2') && c[1] == '>')){
+		int err = *c == '2';
 
-		//if malloc failed
-		if(seq->pipelines[seq->pl_index]->parsed_cmd == NULL){
-			return MSH_ERR_NOMEM;
+		c += *c == '>' ? 1 : 2;
+		if(*c == '>'){
+			c++;
+			*tok = err ? msh_redir_err_append : msh_redir_out_append;
+		} else{
+			*tok = err ? msh_redir_err : msh_redir_out;
 		}
+		*pos = c;
+		return MSH_TOKEN_REDIR;
+	}
 
-		strcpy(seq->pipelines[seq->pl_index]->parsed_cmd, token1);
+	size_t len = strcspn(c, " \t;|&>");
+	memcpy(*words, c, len);
+	(*words)[len] = '\0';
+	*tok = *words;
+	*words += len + 1;
+	*pos = c + len;
 
-		//last index to determine which command is the last in the pipeline
-		unsigned int last_idx = 0;
-		(void)last_idx;
+	return MSH_TOKEN_WORD;
+}
 
-		for(char* token2 = strtok_r(token1, "|", &token1); token2 != NULL; token2 = strtok_r(NULL, "|", &token1)){
-			if(strcmp(token2, " ") == 0){
-				free(free_ptr);
-				return MSH_ERR_PIPE_MISSING_CMD;
-			}
-			
-			//short hand name for the pipe index
-			unsigned int pipe_idx = seq->pl_index;
-
-			//if the parse command is a &, set the pipeline into the background
-			
-
-			for(char* token3 = strtok_r(token2, " ", &token2); token3 != NULL; token3 = strtok_r((NULL), " ", &token2)){
-				//short hand name for the command index
-				unsigned int cmd_idx = seq->pipelines[pipe_idx]->cmd_index;
-				//number of arguments in the command to be added
-				unsigned int args_cnt = seq->pipelines[pipe_idx]->commands[cmd_idx]->args_count;
-				//check for bg or fg
-				if(strcmp(token3, "&") == 0 && seq->pipelines[pipe_idx]->background == 1){
-					free(free_ptr);
-					return MSH_ERR_MISUSED_BACKGROUND;
-				}
-				if(strcmp(token3, "&") == 0 && seq->pipelines[pipe_idx]->parsed_cmd[strlen(seq->pipelines[pipe_idx]->parsed_cmd) - 1] != '&'){
-					free(free_ptr);
-					return MSH_ERR_MISUSED_BACKGROUND;
-				}
+//parses the sequence in a single pass over the line. The words are copied once,
+//into a buffer shared by all of the pipelines, that the arguments point into.
+msh_err_t msh_sequence_parse(char *str, struct msh_sequence *seq){
+	if(str == NULL || seq == NULL || strcmp(str, "") == 0){
+		return MSH_ERR_PIPE_MISSING_CMD;
+	}
 
-				if(strcmp(token3, "&") == 0){
-					seq->pipelines[pipe_idx]->background = 1;
-					continue;
+	//the words, then the line again where each pipeline's text is cut out of
+	size_t len = strlen(str);
+	struct msh_line *line = msh_line_get(2 * (len + 1));
+	if(line == NULL){
+		return MSH_ERR_NOMEM;
+	}
+	char *words = line->text;
+	char *text = line->text + len + 1;
+	memcpy(text, str, len + 1);
+
+	const char *pos = str;
+	const char *pl_start = str;
+	struct msh_pipeline *p = NULL;
+	struct msh_command *c = NULL;
+	//whether the last token was a pipe, or a redirection waiting for its file
+	int piped = 0, redirected = 0;
+	msh_err_t err = 0;
+	char *tok;
+	unsigned int parsed[MSH_POOL_PIPELINES] = { 0 };
+
+	for(enum msh_token kind = MSH_TOKEN_WORD; kind != MSH_TOKEN_END && err == 0;){
+		kind = msh_lex(&pos, &words, &tok);
+
+		if(redirected && kind != MSH_TOKEN_WORD){
+			err = MSH_ERR_NO_REDIR_FILE;
+			break;
+		}
+		switch(kind){
+		case MSH_TOKEN_WORD:
+		case MSH_TOKEN_REDIR:
+			//the first token starts the next pipeline, with a command for each
+			//pipe up to the next semicolon, and one more
+			if(p == NULL){
+				unsigned int ncmds = 1;
+
+				if(seq->pl_count == seq->pl_cap && msh_sequence_grow(seq) != 0){
+					err = MSH_ERR_NOMEM;
+					break;
 				}
-
-				
-
-				//check for 
-				//add the argument to the command
-				if(seq->pipelines[pipe_idx]->commands[cmd_idx]->args[args_cnt] == NULL){
-					seq->pipelines[pipe_idx]->commands[cmd_idx]->args[args_cnt] = malloc(128);
+				for(const char *ch = pl_start; *ch != '\0' && *ch != ';'; ch++){
+					ncmds += *ch == '|';
 				}
-
-				//if malloc failed, return the no memory error
-				if(seq->pipelines[pipe_idx]->commands[cmd_idx]->args[args_cnt] == NULL){
-					free(free_ptr);
-					return MSH_ERR_NOMEM;
+				p = msh_pipeline_alloc(ncmds);
+				if(p == NULL){
+					err = MSH_ERR_NOMEM;
+					break;
 				}
+				parsed[msh_pipeline_class(ncmds)]++;
+				*msh_sequence_slot(seq, seq->pl_count) = p;
+				p->line = line;
+				line->refs++;
+				c = &p->commands[0];
+			}
+			//the args stay NULL-terminated, in the command until they outgrow it
+			if(c->args == NULL){
+				c->args = c->args_inline;
+				c->args_cap = MSH_ARGS_INLINE;
+			}
+			if(c->args_count + 1 == c->args_cap){
+				char **args = msh_grow(c->args, &c->args_cap, c->args_inline);
 
-				//if there's too many args, return the max args error
-				if(seq->pipelines[pipe_idx]->commands[cmd_idx]->args_count >= MSH_MAXARGS){
-					free(free_ptr);
-					return MSH_ERR_TOO_MANY_ARGS;
+				if(args == NULL){
+					err = MSH_ERR_NOMEM;
+					break;
 				}
-
-				//strcpy the args into the array of args
-				strcpy(seq->pipelines[pipe_idx]->commands[cmd_idx]->args[args_cnt], token3);
-
-				//update the count
-				seq->pipelines[pipe_idx]->commands[cmd_idx]->args_count = seq->pipelines[pipe_idx]->commands[cmd_idx]->args_count + 1;
-				
+				c->args = args;
 			}
-
-			//update the last index
-			last_idx = seq->pipelines[seq->pl_index]->cmd_index;
-
-			//update the command counts
-			seq->pipelines[seq->pl_index]->cmd_count = seq->pipelines[seq->pl_index]->cmd_count + 1;
-			seq->pipelines[seq->pl_index]->cmd_index = seq->pipelines[seq->pl_index]->cmd_index + 1;
-
-			//if there's too many commands, return the max command error
-			if(seq->pipelines[seq->pl_index]->cmd_count >= MSH_MAXCMNDS){
-				free(free_ptr);
-				return MSH_ERR_TOO_MANY_CMDS;
+			c->args[c->args_count++] = tok;
+			c->args[c->args_count] = NULL;
+			redirected = kind == MSH_TOKEN_REDIR;
+			piped = 0;
+			break;
+		case MSH_TOKEN_PIPE:
+			if(c == NULL || c->args_count == 0){
+				err = MSH_ERR_PIPE_MISSING_CMD;
+				break;
 			}
-			
-
+			p->cmd_count++;
+			p->cmd_index++;
+			c = &p->commands[p->cmd_index];
+			piped = 1;
+			break;
+		case MSH_TOKEN_AMP:
+			//`&` ends the pipeline, e.g. not "cmd & &" or "cmd & "
+			if((p != NULL && p->background) || (*pos != '\0' && *pos != ';')){
+				err = MSH_ERR_MISUSED_BACKGROUND;
+			} else if(c == NULL || c->args_count == 0){
+				err = piped ? MSH_ERR_PIPE_MISSING_CMD : MSH_ERR_SEQ_REDIR_OR_BACKGROUND_MISSING_CMD;
+			} else{
+				p->background = 1;
+			}
+			break;
+		case MSH_TOKEN_SEMI:
+		case MSH_TOKEN_END:
+			//a pipeline can only be empty at the end, e.g. "cmd ;" but not "; cmd"
+			if(p == NULL){
+				if(kind == MSH_TOKEN_SEMI && *(pos + strspn(pos, " \t")) != '\0'){
+					err = MSH_ERR_SEQ_MISSING_CMD;
+				}
+				pl_start = pos;
+				break;
+			}
+			if(piped){
+				err = MSH_ERR_PIPE_MISSING_CMD;
+				break;
+			}
+			p->commands[p->cmd_index].last_cmd = 1;
+			p->cmd_count++;
+			p->cmd_index++;
+
+			//the pipeline's text, as it was typed
+			p->parsed_cmd = text + (pl_start - str);
+			p->parsed_cmd[pos - pl_start - (kind == MSH_TOKEN_SEMI)] = '\0';
+			pl_start = pos;
+
+			seq->pl_count++;
+			p = NULL;
+			c = NULL;
+			break;
 		}
-		//change the last command boolean value
-		seq->pipelines[seq->pl_index]->commands[last_idx]->last_cmd = 1;
-
-		//update the counts
-		seq->pl_count = seq->pl_count + 1;
-		seq->pl_index = seq->pl_index + 1;
+	}
 
-	
+	//a pipeline cut short by an error is not queued
+	if(p != NULL){
+		*msh_sequence_slot(seq, seq->pl_count) = NULL;
+		msh_pipeline_free(p);
 	}
 
-	//free the strdup
-	free(free_ptr);
+	//the pipelines hold the line now, if any of them took it
+	msh_line_put(line);
+	msh_pool_resize(parsed);
 
-	//return 0 if nothing happened
-	return 0;
+	return err;
 }
 
-//gets the first pipeline and holds it
+//dequeues the first pipeline, passing it to the caller
 struct msh_pipeline *msh_sequence_pipeline(struct msh_sequence *s){
-	(void)s;
-	//dequeue the first pipeline and hold it
-	struct msh_pipeline* holder = s->pipelines[0];
-
-	//if the holder is null, then the pipeline is empty
-	if(holder == NULL){
+	//if there are no pipelines, then the sequence is empty
+	if(s->pl_count == 0){
 		return NULL;
 	}
 
-	//shift everything down the queue
-	for(unsigned int i = 0; i < s->pl_count - 1; i++){
-		s->pipelines[i] = s->pipelines[i + 1];
-	}
-
-	//set the end to null
-	s->pipelines[s->pl_count - 1] = NULL;
-	
+	//take the first pipeline, and the queue starts at the next one
+	struct msh_pipeline **slot = msh_sequence_slot(s, 0);
+	struct msh_pipeline* holder = *slot;
+	*slot = NULL;
+	s->pl_head = (s->pl_head + 1) & (s->pl_cap - 1);
+	s->pl_count--;
 
-	//return the holder
 	return holder;
 }
 
@@ -379,12 +638,7 @@ struct msh_command *msh_pipeline_command(struct msh_pipeline *p, size_t nth){
 	}
 
 	//return the nth command
-	if(p->commands[nth] != NULL){
-		return p->commands[nth];
-	}
-
-	//return NULL for errors
-	return NULL;
+	return &p->commands[nth];
 }
 
 int msh_pipeline_background(struct msh_pipeline *p){
@@ -458,10 +712,12 @@ void * msh_command_getdata(struct msh_command *c){
 
 void print_sequence(struct msh_sequence* s){
 	for(unsigned int i = 0; i < s->pl_count; i++){
-		for(unsigned int j = 0; i < s->pipelines[i]->cmd_count; j++){
-			printf("PARSED PIPELINE: %s\n", s->pipelines[i]->parsed_cmd);
-			for(unsigned int k = 0; k < s->pipelines[i]->commands[j]->args_count; k++){
-				printf("	ARGS: %s\n", s->pipelines[i]->commands[j]->args[k]);
+		struct msh_pipeline* p = *msh_sequence_slot(s, i);
+
+		for(unsigned int j = 0; j < p->cmd_count; j++){
+			printf("PARSED PIPELINE: %s\n", p->parsed_cmd);
+			for(unsigned int k = 0; k < p->commands[j].args_count; k++){
+				printf("	ARGS: %s\n", p->commands[j].args[k]);
 			}
 		}
 	}
@@ -18,7 +18,9 @@ struct msh_sequence *msh_sequence_alloc(void);
 
 /**
  * `msh_pipeline_parse` takes the command string, parses it, and
- * inserts pipelines therein into the sequence queue.
+ * inserts pipelines therein into the sequence queue, after any that
+ * are still in it. A pipeline that has an error is not queued, the
+ * ones before it are.
  *
  * - `@str` - the string holding pipelines and commands. This function
  *     borrows this string, thus does not `free` it.
@@ -38,13 +40,38 @@ msh_err_t msh_sequence_parse(char *str, struct msh_sequence *s);
  */
 void msh_sequence_free(struct msh_sequence *s);
 
+/**
+ * `msh_sequence_reset` empties a sequence so that the next line can be
+ * parsed into it, freeing the pipelines still in it. Reusing a sequence
+ * this way, rather than allocating one per line, lets the parser reuse
+ * the memory of the previous lines: freed pipelines and the buffers of
+ * their lines are pooled, so that once the shell has run for a bit,
+ * parsing a line does not allocate. The pool keeps at least as many
+ * pipelines of each size as the last line had, however many and long
+ * they were, along with the room their commands grew for arguments.
+ *
+ * - `s` - The sequence to reset.
+ */
+void msh_sequence_reset(struct msh_sequence *s);
+
+/**
+ * `msh_parse_allocations` returns how many allocations the parser has
+ * made so far, for sequences, pipelines with their commands, and the
+ * lines they were parsed from. The difference before and after a call
+ * is how many that call made: a sequence takes one, and parsing a line
+ * up to one, plus one for each of its pipelines, unless they are
+ * reused from the pool (see `msh_sequence_reset`).
+ */
+size_t msh_parse_allocations(void);
+
 /**
  * `msh_sequence_pipeline` dequeues the first pipeline in the sequence.
+ * The queue is a ring buffer, so this takes constant time however many
+ * pipelines are queued.
  *
  * - `@s` - the sequence we're querying
- * - `@return` - return a pointer to the zero-indexed `nth` command in
- *     the pipeline, or `NULL` if `nth` >= the number of commands in
- *     the pipeline. The caller of this function is passed the
+ * - `@return` - return a pointer to the first pipeline, or `NULL` if
+ *     the sequence is empty. The caller of this function is passed the
  *     ownership for the pipeline, thus must free the pipeline.
  */
 struct msh_pipeline *msh_sequence_pipeline(struct msh_sequence *s);
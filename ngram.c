@@ -0,0 +1,397 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ngram.h>
+
+//the hash tables start with this many slots, and double once half full
+#define NGRAM_TABLE_MIN 1024
+
+//the strings holding one trigram, by id in the order they were added. A
+//trigram is its three bytes with a bit above them set, so that 0 marks an
+//empty slot of the table.
+struct ngram_postings{
+    uint32_t gram;
+    uint32_t n;
+    uint32_t cap;
+    uint32_t* ids;
+};
+
+struct ngram{
+    //the strings back to back, NUL-terminated, and for each of them by id:
+    //where it starts in `pool`, its rank, and whether it is in the index. A removed
+    //string keeps its id and postings, which searches skip, until the index is
+    //rebuilt once most of its strings are removed.
+    char* pool;
+    size_t pool_len;
+    size_t pool_cap;
+    uint32_t* offs;
+    double* ranks;
+    unsigned char* live;
+    size_t n;
+    size_t nlive;
+    size_t cap;
+
+    //hash table from a string to its id plus one (0 for an empty slot), to
+    //find a string that is added again or removed
+    uint32_t* strs;
+    size_t strs_cap;
+
+    //hash table from a trigram to the strings holding it
+    struct ngram_postings* grams;
+    size_t grams_cap;
+    size_t ngrams;
+};
+
+//a string found by a search
+struct ngram_hit{
+    double rank;
+    uint32_t id;
+};
+
+static uint64_t hash_str(const char* str){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for(const unsigned char* c = (const unsigned char*)str; *c != '\0'; c++){
+        hash = (hash ^ *c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_gram(uint32_t gram){
+    return gram * 0x9e3779b97f4a7c15ULL >> 20;
+}
+
+static uint32_t gram_at(const char* str){
+    const unsigned char* c = (const unsigned char*)str;
+
+    return 1u << 24 | (uint32_t)c[0] << 16 | (uint32_t)c[1] << 8 | c[2];
+}
+
+struct ngram *ngram_allocate(void){
+    struct ngram* ng = calloc(1, sizeof(struct ngram));
+
+    if(ng == NULL){
+        return NULL;
+    }
+    ng->strs = calloc(NGRAM_TABLE_MIN, sizeof(uint32_t));
+    ng->grams = calloc(NGRAM_TABLE_MIN, sizeof(struct ngram_postings));
+    if(ng->strs == NULL || ng->grams == NULL){
+        ngram_free(ng);
+        return NULL;
+    }
+    ng->strs_cap = NGRAM_TABLE_MIN;
+    ng->grams_cap = NGRAM_TABLE_MIN;
+
+    return ng;
+}
+
+void ngram_free(struct ngram *ng){
+    if(ng == NULL){
+        return;
+    }
+    for(size_t i = 0; ng->grams != NULL && i < ng->grams_cap; i++){
+        free(ng->grams[i].ids);
+    }
+    free(ng->grams);
+    free(ng->strs);
+    free(ng->pool);
+    free(ng->offs);
+    free(ng->ranks);
+    free(ng->live);
+    free(ng);
+}
+
+//the slot of the table of strings that holds `str`, or the empty one it would go in
+static uint32_t* str_slot(struct ngram* ng, const char* str){
+    size_t mask = ng->strs_cap - 1;
+
+    for(size_t i = hash_str(str) & mask; ; i = (i + 1) & mask){
+        if(ng->strs[i] == 0 || strcmp(ng->pool + ng->offs[ng->strs[i] - 1], str) == 0){
+            return &ng->strs[i];
+        }
+    }
+}
+
+//the slot of the table of trigrams that holds `gram`, or the empty one it would go in
+static struct ngram_postings* gram_slot(struct ngram* ng, uint32_t gram){
+    size_t mask = ng->grams_cap - 1;
+
+    for(size_t i = hash_gram(gram) & mask; ; i = (i + 1) & mask){
+        if(ng->grams[i].gram == 0 || ng->grams[i].gram == gram){
+            return &ng->grams[i];
+        }
+    }
+}
+
+//doubles the table of strings once it is half full
+static int grow_strs(struct ngram* ng){
+    if((ng->n + 1) * 2 <= ng->strs_cap){
+        return 0;
+    }
+
+    uint32_t* old = ng->strs;
+    size_t old_cap = ng->strs_cap;
+    ng->strs = calloc(old_cap * 2, sizeof(uint32_t));
+    if(ng->strs == NULL){
+        ng->strs = old;
+        return -1;
+    }
+    ng->strs_cap = old_cap * 2;
+    for(size_t i = 0; i < old_cap; i++){
+        if(old[i] != 0){
+            *str_slot(ng, ng->pool + ng->offs[old[i] - 1]) = old[i];
+        }
+    }
+    free(old);
+
+    return 0;
+}
+
+//doubles the table of trigrams once it is half full
+static int grow_grams(struct ngram* ng){
+    if((ng->ngrams + 1) * 2 <= ng->grams_cap){
+        return 0;
+    }
+
+    struct ngram_postings* old = ng->grams;
+    size_t old_cap = ng->grams_cap;
+    ng->grams = calloc(old_cap * 2, sizeof(struct ngram_postings));
+    if(ng->grams == NULL){
+        ng->grams = old;
+        return -1;
+    }
+    ng->grams_cap = old_cap * 2;
+    for(size_t i = 0; i < old_cap; i++){
+        if(old[i].gram != 0){
+            *gram_slot(ng, old[i].gram) = old[i];
+        }
+    }
+    free(old);
+
+    return 0;
+}
+
+//appends the string `id` to the strings holding `gram`, once
+static int add_posting(struct ngram* ng, uint32_t gram, uint32_t id){
+    if(grow_grams(ng) != 0){
+        return -1;
+    }
+
+    struct ngram_postings* p = gram_slot(ng, gram);
+    if(p->gram == 0){
+        p->gram = gram;
+        ng->ngrams++;
+    }
+
+    //a trigram repeated within the string is already there
+    if(p->n > 0 && p->ids[p->n - 1] == id){
+        return 0;
+    }
+    if(p->n == p->cap){
+        uint32_t cap = p->cap == 0 ? 4 : p->cap * 2;
+        uint32_t* ids = realloc(p->ids, cap * sizeof(uint32_t));
+
+        if(ids == NULL){
+            return -1;
+        }
+        p->ids = ids;
+        p->cap = cap;
+    }
+    p->ids[p->n++] = id;
+
+    return 0;
+}
+
+//makes room for one more string of `len` characters
+static int reserve_str(struct ngram* ng, size_t len){
+    if(ng->pool_len + len + 1 > UINT32_MAX || grow_strs(ng) != 0){
+        return -1;
+    }
+    if(ng->pool_len + len + 1 > ng->pool_cap){
+        size_t cap = ng->pool_cap == 0 ? 4096 : ng->pool_cap;
+
+        while(cap < ng->pool_len + len + 1){
+            cap *= 2;
+        }
+        char* pool = realloc(ng->pool, cap);
+        if(pool == NULL){
+            return -1;
+        }
+        ng->pool = pool;
+        ng->pool_cap = cap;
+    }
+    if(ng->n == ng->cap){
+        size_t cap = ng->cap == 0 ? 256 : ng->cap * 2;
+        uint32_t* offs = realloc(ng->offs, cap * sizeof(uint32_t));
+
+        if(offs == NULL){
+            return -1;
+        }
+        ng->offs = offs;
+        double* ranks = realloc(ng->ranks, cap * sizeof(double));
+        if(ranks == NULL){
+            return -1;
+        }
+        ng->ranks = ranks;
+        unsigned char* live = realloc(ng->live, cap);
+        if(live == NULL){
+            return -1;
+        }
+        ng->live = live;
+        ng->cap = cap;
+    }
+
+    return 0;
+}
+
+int ngram_add(struct ngram *ng, const char *str, double rank){
+    size_t len = strlen(str);
+    uint32_t* slot = str_slot(ng, str);
+    int ret = 0;
+
+    //a string already there only takes the new rank, and is brought back if it was removed
+    if(*slot != 0){
+        ng->ranks[*slot - 1] = rank;
+        if(!ng->live[*slot - 1]){
+            ng->live[*slot - 1] = 1;
+            ng->nlive++;
+        }
+        return 0;
+    }
+    if(reserve_str(ng, len) != 0){
+        return -1;
+    }
+
+    //the table of strings may have grown, so find the slot again
+    uint32_t id = ng->n++;
+    memcpy(ng->pool + ng->pool_len, str, len + 1);
+    ng->offs[id] = ng->pool_len;
+    ng->ranks[id] = rank;
+    ng->live[id] = 1;
+    ng->nlive++;
+    ng->pool_len += len + 1;
+    *str_slot(ng, str) = id + 1;
+
+    for(size_t i = 0; i + 3 <= len; i++){
+        if(add_posting(ng, gram_at(str + i), id) != 0){
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+//rebuilds the index from the strings still in it, in the order they were added,
+//leaving it as it is if that fails
+static void ngram_compact(struct ngram* ng){
+    struct ngram* fresh = ngram_allocate();
+
+    if(fresh == NULL){
+        return;
+    }
+    for(size_t id = 0; id < ng->n; id++){
+        if(ng->live[id] && ngram_add(fresh, ng->pool + ng->offs[id], ng->ranks[id]) != 0){
+            ngram_free(fresh);
+            return;
+        }
+    }
+
+    //take over the fresh index, and free the old one through it
+    struct ngram old = *ng;
+    *ng = *fresh;
+    *fresh = old;
+    ngram_free(fresh);
+}
+
+int ngram_remove(struct ngram *ng, const char *str){
+    uint32_t* slot = str_slot(ng, str);
+
+    if(*slot == 0 || !ng->live[*slot - 1]){
+        return -1;
+    }
+    ng->live[*slot - 1] = 0;
+    ng->nlive--;
+
+    //the removed strings still take memory, so they are dropped once they are most of it
+    if(ng->n - ng->nlive > ng->nlive){
+        ngram_compact(ng);
+    }
+    return 0;
+}
+
+//higher rank first, then added last
+static int hit_better(struct ngram_hit a, struct ngram_hit b){
+    if(a.rank != b.rank){
+        return a.rank > b.rank;
+    }
+    return a.id > b.id;
+}
+
+//inserts the string `id` into the sorted `hits` if it is among the `k` best and
+//holds `substr`. The candidates come newest first, so once `hits` is full only
+//one ranked higher can get in, and the others are dropped before looking into
+//them.
+static void hits_offer(struct ngram* ng, struct ngram_hit* hits, size_t* n, size_t k, uint32_t id,
+                       const char* substr){
+    struct ngram_hit hit = { ng->ranks[id], id };
+
+    if(!ng->live[id] || (*n == k && !hit_better(hit, hits[k - 1]))){
+        return;
+    }
+    if(strstr(ng->pool + ng->offs[id], substr) == NULL){
+        return;
+    }
+
+    size_t i = *n < k ? (*n)++ : k - 1;
+    while(i > 0 && hit_better(hit, hits[i - 1])){
+        hits[i] = hits[i - 1];
+        i--;
+    }
+    hits[i] = hit;
+}
+
+size_t ngram_search(struct ngram *ng, const char *substr, size_t k, const char **out){
+    size_t len = strlen(substr);
+    struct ngram_hit* hits;
+    size_t n = 0;
+
+    if(k == 0){
+        return 0;
+    }
+    hits = malloc(k * sizeof(struct ngram_hit));
+    if(hits == NULL){
+        return 0;
+    }
+
+    if(len < 3){
+        //too short for a trigram, every string is a candidate
+        for(size_t id = ng->n; id-- > 0;){
+            hits_offer(ng, hits, &n, k, id, substr);
+        }
+    } else{
+        //the strings holding the substring all hold its rarest trigram, so
+        //only those are checked
+        struct ngram_postings* rarest = NULL;
+
+        for(size_t i = 0; i + 3 <= len; i++){
+            struct ngram_postings* p = gram_slot(ng, gram_at(substr + i));
+
+            if(p->gram == 0){
+                rarest = NULL;
+                break;
+            }
+            if(rarest == NULL || p->n < rarest->n){
+                rarest = p;
+            }
+        }
+        for(uint32_t i = rarest == NULL ? 0 : rarest->n; i-- > 0;){
+            hits_offer(ng, hits, &n, k, rarest->ids[i], substr);
+        }
+    }
+
+    for(size_t i = 0; i < n; i++){
+        out[i] = ng->pool + ng->offs[hits[i].id];
+    }
+    free(hits);
+
+    return n;
+}
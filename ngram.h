@@ -0,0 +1,67 @@
+#ifndef NGRAM_H
+#define NGRAM_H
+
+#include <stddef.h>
+
+/***
+ * The n-gram index finds the strings that contain a given substring,
+ * anywhere in them, for searching through the history the way
+ * reverse-i-search does. Every run of three characters (trigram) of
+ * every string points to the strings holding it, so a search only
+ * looks at the strings holding all of the trigrams of the substring
+ * rather than at every string. Strings are added one at a time, and
+ * are searchable right away.
+ */
+struct ngram;
+
+/**
+ * `ngram_allocate` allocates a new, empty index, `NULL` if it could
+ * not be, and `ngram_free` frees it.
+ */
+struct ngram *ngram_allocate(void);
+void ngram_free(struct ngram *ng);
+
+/**
+ * `ngram_add` adds a string to the index, or if it is already there,
+ * sets its rank.
+ *
+ * - `@ng` - The index.
+ * - `@str` - The string, *borrowed* from the caller.
+ * - `@rank` - How high the string ranks in searches, for example its
+ *     frecency in the history (see `ptrie_rank`), which is passed
+ *     again each time it changes.
+ * - `@return` - `0` on success, `-1` on `malloc` failure.
+ */
+int ngram_add(struct ngram *ng, const char *str, double rank);
+
+/**
+ * `ngram_remove` takes a string out of the index, so that the index
+ * can follow a bounded set of strings, like the history once it
+ * evicts old entries. The memory of removed strings is given back
+ * once they are most of the index.
+ *
+ * - `@ng` - The index.
+ * - `@str` - The string, *borrowed* from the caller.
+ * - `@return` - `0` on success, `-1` if `str` is not in the index.
+ */
+int ngram_remove(struct ngram *ng, const char *str);
+
+/**
+ * `ngram_search` finds the `k` best strings containing `substr`: the
+ * highest ranked, and among those ranked equally, the most recently
+ * added first.
+ *
+ * Arguments:
+ *
+ * - `@ng` - The index.
+ * - `@substr` - The substring to look for. Substrings shorter than a
+ *     trigram are looked for in every string.
+ * - `@k` - The maximum number of strings to return.
+ * - `@out` - An array of at least `k` entries that is filled with the
+ *     strings, best first. They are *borrowed* from the index, and
+ *     valid until the next `ngram_add`, `ngram_remove` or `ngram_free`.
+ * - `@return` - The number of strings placed in `out`.
+ */
+size_t ngram_search(struct ngram *ng, const char *substr, size_t k, const char **out);
+
+#endif /* NGRAM_H */
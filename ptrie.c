@@ -1,26 +1,361 @@
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <search.h>
 #include <stdio.h>
 #include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <ptrie.h>
+#include <arena.h>
+#include <argmax.h>
+#include <epoch.h>
+
+/*
+ * A node of the path-compressed (radix) trie. Instead of one node per
+ * character, the edge from a parent to this node is labeled with the whole
+ * run of characters that no other key branches off of, so a key only costs
+ * the bytes of its unique suffix plus a single node.
+ *
+ * Nodes come in adaptive sizes: most nodes have zero, one or two children,
+ * so a node only carries as many child slots as its fan-out needs and is
+ * regrown into the next size when it fills up. `struct ptrie_node` is the
+ * header shared by all of them; `type` says which of the structs below it is
+ * embedded in.
+ */
+enum ptrie_node_type{
+    PTRIE_NODE0,
+    PTRIE_NODE4,
+    PTRIE_NODE16,
+    PTRIE_NODE48,
+    PTRIE_NODE256,
+};
 
-struct ptrie{
-    struct ptrie_node* root;
+struct ptrie_node{
+    //the edge label leading into this node (not NUL-terminated)
+    const char* label;
+    unsigned int len;
+
+    //the key ending at this node, or NULL
+    struct ptrie_key* key;
+
+    //the best completion in this node's subtree (the highest rank, the lowest
+    //`ptrie_char2off` on ties), or NULL if the subtree has no key
+    struct ptrie_key* best;
+
+    //which adaptive node this is, and how many children it has
+    unsigned char type;
+    unsigned short nchildren;
 };
 
-struct ptrie_entry{
-    struct ptrie_node* next;
+//a key added to the ptrie. Every key is stored exactly once, exact-sized, in
+//one of these records: the edge labels of the nodes are slices of the keys'
+//bytes rather than copies. Keys live apart from the nodes, so that regrowing a
+//node does not move the keys that its ancestors point to as their best.
+struct ptrie_key{
+    //what completions are ranked by: how many times the key was added, or if
+    //the ptrie has a half-life, log2 of the sum of 2^(t / half-life) over the
+    //times t (since the ptrie's epoch) it was added at
+    double rank;
+
+    //how many times the key was added
     unsigned int count;
-    unsigned int max;
-    char* pointer; 
+    unsigned int len;
+    char str[];
+};
+
+//every key of a modifiable ptrie is preceded by its place in the ptrie's list
+//of keys from the most to the least recently added, which eviction walks from
+//the old end. Frozen keys do not have one.
+struct ptrie_lru{
+    struct ptrie_lru* newer;
+    struct ptrie_lru* older;
+};
+
+//keys are allocated in power-of-two size classes from 32 bytes up, so that the
+//memory of evicted keys is reused
+#define PTRIE_KEY_CLASSES 24
+#define PTRIE_KEY_MIN 32
+
+//when over budget, the key evicted is the lowest ranked among this many of
+//the least recently added keys
+#define PTRIE_EVICT_WINDOW 8
+
+/*
+ * A frozen ptrie is compacted into a single block: a header, then every node,
+ * then the first character of every node's label, then the keys. Each node's
+ * children are stored next to each other in character order, and the groups
+ * of children are laid out in depth-first order, so a lookup scans a few
+ * contiguous bytes per level and stays within a few cache lines. Everything
+ * refers to everything else by index or offset.
+ */
+#define PTRIE_FROZEN_NONE UINT32_MAX
+
+struct ptrie_frozen{
+    //the size of the whole block in bytes
+    uint64_t size;
+    uint32_t nnodes;
+
+    //offsets of the first-character array and of the keys in the block
+    uint32_t fchars;
+    uint32_t keys;
 };
 
+struct ptrie_fnode{
+    //offset of the label in the keys area (it is part of a key in the subtree)
+    uint32_t label;
+    uint32_t len;
 
-struct ptrie_node{
-    struct ptrie_entry entries[256];
+    //offsets in the keys area of the `struct ptrie_key` ending here (or
+    //PTRIE_FROZEN_NONE), and of the best key in the subtree
+    uint32_t key;
+    uint32_t best;
+
+    //the index of the first child, and how many children there are
+    uint32_t child;
+    uint32_t nchildren;
+};
+
+//up to 4 children, `keys` holds the offset of each child's first character, sorted
+struct ptrie_node4{
+    struct ptrie_node n;
+    unsigned char keys[4];
+    struct ptrie_node* children[4];
+};
+
+//up to 16 children, same layout as the 4-child node
+struct ptrie_node16{
+    struct ptrie_node n;
+    unsigned char keys[16];
+    struct ptrie_node* children[16];
+};
+
+//`ptrie_char2off` only maps to offsets below this, so that is all that the
+//per-character arrays of the wide nodes have to cover
+#define PTRIE_CHARS 128
+
+//up to 48 children, `index` maps a character offset to its slot in `children` plus one.
+//The wide nodes also keep the fields that finding their best child needs in
+//arrays of their own: a bitmap of the character offsets that have a child, and
+//the rank of each child's best completion, so that a scan touches those few
+//contiguous bytes instead of every child. Here `max` is indexed by slot.
+struct ptrie_node48{
+    struct ptrie_node n;
+    uint64_t present[PTRIE_CHARS / 64];
+    unsigned char index[256];
+    struct ptrie_node* children[48];
+    double max[48];
+};
+
+//a full node, indexed directly by the character offset, `max` too (with
+//-INFINITY where there is no child)
+struct ptrie_node256{
+    struct ptrie_node n;
+    uint64_t present[PTRIE_CHARS / 64];
+    struct ptrie_node* children[256];
+    double max[PTRIE_CHARS];
+};
+
+struct ptrie{
+    struct ptrie_node* root;
+
+    //once frozen, the ptrie is this read-only block instead, and `root` is NULL
+    struct ptrie_frozen* frozen;
+
+    //if the frozen block was loaded with ptrie_load, the file mapping it lives in
+    void* mapping;
+    size_t mapping_size;
+
+    //every node and key of the ptrie is allocated from its arena, the nodes
+    //through a slab per node type so that regrown nodes are recycled
+    struct arena* arena;
+    struct slab slabs[PTRIE_NODE256 + 1];
+
+    //scratch stack of the nodes on the path of the key being added, reused across adds
+    struct ptrie_node** path;
+    unsigned int path_cap;
+
+    //the keys, allocated by size class, and their recency list
+    struct slab key_slabs[PTRIE_KEY_CLASSES];
+    struct ptrie_lru* newest;
+    struct ptrie_lru* oldest;
+
+    //the footprint of the nodes and keys, and the budget it is kept under (0 for none)
+    size_t nkeys;
+    size_t nnodes;
+    size_t bytes;
+    size_t budget;
+
+    //called with each key that eviction is about to drop, see ptrie_set_evicted
+    void (*evicted)(const char* str, void* arg);
+    void* evicted_arg;
+
+    //the half-life of the keys' ranks in seconds (0 for none), and the time the
+    //ranks are relative to
+    double halflife;
+    double epoch;
+
+    //see ptrie_version: a new one is taken from `ptrie_versions` by every call
+    //that may change the ptrie, so no two ptries ever share one
+    uint64_t version;
 };
 
+static _Atomic uint64_t ptrie_versions;
+
+static uint64_t next_version(void){
+    return atomic_fetch_add_explicit(&ptrie_versions, 1, memory_order_relaxed) + 1;
+}
+
+//maps a character to its offset among a node's children, -1 if the character
+//is not allowed in the ptrie. Lower offsets win frequency ties.
+static int ptrie_char2off(char c){
+    int off = (int)c;
+
+    if(off <= 0 || off >= 128){
+        return -1;
+    }
+
+    return off;
+}
+
+//the size of each adaptive node type
+static size_t node_size(unsigned char type){
+    switch(type){
+    case PTRIE_NODE4:   return sizeof(struct ptrie_node4);
+    case PTRIE_NODE16:  return sizeof(struct ptrie_node16);
+    case PTRIE_NODE48:  return sizeof(struct ptrie_node48);
+    case PTRIE_NODE256: return sizeof(struct ptrie_node256);
+    default:            return sizeof(struct ptrie_node);
+    }
+}
+
+//takes a zeroed node of the given type from its slab
+static struct ptrie_node* alloc_node(struct ptrie* pt, unsigned char type){
+    struct ptrie_node* node = slab_alloc(&pt->slabs[type]);
+
+    if(node != NULL){
+        pt->nnodes++;
+        pt->bytes += node_size(type);
+    }
+    if(node != NULL && type == PTRIE_NODE256){
+        //no child yet, so that none of them wins the best child
+        for(unsigned int i = 0; i < PTRIE_CHARS; i++){
+            ((struct ptrie_node256*)node)->max[i] = -INFINITY;
+        }
+    }
+    return node;
+}
+
+//this creates a new, unlabeled ptrie node of the given type
+static struct ptrie_node* create_node(struct ptrie* pt, unsigned char type){
+
+    //take a zeroed node from the slab of its type
+    struct ptrie_node* node = alloc_node(pt, type);
+
+    //sanity check
+    if(node == NULL){
+        return NULL;
+    }
+    node->type = type;
+
+    //return the node itself
+    return node;
+}
+
+//the size class of a key of `len` characters, with its recency list entry
+static unsigned int key_class(unsigned int len){
+    size_t size = sizeof(struct ptrie_lru) + sizeof(struct ptrie_key) + len + 1;
+    unsigned int class = 0;
+
+    while(class < PTRIE_KEY_CLASSES && ((size_t)PTRIE_KEY_MIN << class) < size){
+        class++;
+    }
+    return class;
+}
+
+//the recency list entry in front of a key
+static struct ptrie_lru* key_lru(struct ptrie_key* key){
+    return (struct ptrie_lru*)key - 1;
+}
+
+static struct ptrie_key* lru_key(struct ptrie_lru* lru){
+    return (struct ptrie_key*)(lru + 1);
+}
+
+//unlinks a key from the recency list
+static void lru_unlink(struct ptrie* pt, struct ptrie_lru* lru){
+    if(lru->newer != NULL){
+        lru->newer->older = lru->older;
+    } else{
+        pt->newest = lru->older;
+    }
+    if(lru->older != NULL){
+        lru->older->newer = lru->newer;
+    } else{
+        pt->oldest = lru->newer;
+    }
+}
+
+//links a key in as the most recently added one
+static void lru_push(struct ptrie* pt, struct ptrie_lru* lru){
+    lru->newer = NULL;
+    lru->older = pt->newest;
+    if(pt->newest != NULL){
+        pt->newest->newer = lru;
+    } else{
+        pt->oldest = lru;
+    }
+    pt->newest = lru;
+}
+
+//stores the `len` characters of `str` as a new key, the most recent one
+static struct ptrie_key* intern_key(struct ptrie* pt, const char* str, unsigned int len){
+    unsigned int class = key_class(len);
+
+    if(class == PTRIE_KEY_CLASSES){
+        return NULL;
+    }
+
+    struct ptrie_lru* lru = slab_alloc(&pt->key_slabs[class]);
+    if(lru == NULL){
+        return NULL;
+    }
+    struct ptrie_key* key = lru_key(lru);
+    key->rank = 0;
+    key->count = 0;
+    key->len = len;
+    memcpy(key->str, str, len);
+    key->str[len] = '\0';
+
+    lru_push(pt, lru);
+    pt->nkeys++;
+    pt->bytes += (size_t)PTRIE_KEY_MIN << class;
+
+    return key;
+}
+
+//gives a key that no node refers to anymore back to its slab
+static void free_key(struct ptrie* pt, struct ptrie_key* key){
+    unsigned int class = key_class(key->len);
+
+    lru_unlink(pt, key_lru(key));
+    pt->nkeys--;
+    pt->bytes -= (size_t)PTRIE_KEY_MIN << class;
+    slab_free(&pt->key_slabs[class], key_lru(key));
+}
+
+//gives a node back to the slab of its type
+static void free_node(struct ptrie* pt, struct ptrie_node* node){
+    pt->nnodes--;
+    pt->bytes -= node_size(node->type);
+    slab_free(&pt->slabs[node->type], node);
+}
 
 //creates the ptrie
 struct ptrie *ptrie_allocate(void){
@@ -29,10 +364,26 @@ struct ptrie *ptrie_allocate(void){
     if(tree == NULL){
         return NULL;
     }
+    tree->version = next_version();
+
+    //set up the arena and a slab for each node type
+    tree->arena = arena_create(ARENA_HUGEPAGES);
+    if(tree->arena == NULL){
+        free(tree);
+        return NULL;
+    }
+    for(unsigned char type = PTRIE_NODE0; type <= PTRIE_NODE256; type++){
+        slab_init(&tree->slabs[type], tree->arena, node_size(type));
+    }
+    for(unsigned int class = 0; class < PTRIE_KEY_CLASSES; class++){
+        slab_init(&tree->key_slabs[class], tree->arena, (size_t)PTRIE_KEY_MIN << class);
+    }
 
-    //malloc the root of the tree
-    tree->root = calloc(1, sizeof(struct ptrie_node));
+    //allocate the root of the tree
+    tree->root = create_node(tree, PTRIE_NODE0);
     if(tree->root == NULL){
+        arena_destroy(tree->arena);
+        free(tree);
         return NULL;
     }
 
@@ -40,288 +391,2069 @@ struct ptrie *ptrie_allocate(void){
     return tree;
 }
 
-//the recursive portion of the free method, frees a node and the node's content
-static void recursive_free(struct ptrie_node *node){
-    //iterate through each entry
-    for(unsigned int i = 0; i < 256; i++){
+//the sorted key and child arrays of a 4- or 16-child node
+static void small_arrays(struct ptrie_node* node, unsigned char** keys, struct ptrie_node*** children){
+    if(node->type == PTRIE_NODE4){
+        *keys = ((struct ptrie_node4*)node)->keys;
+        *children = ((struct ptrie_node4*)node)->children;
+    } else{
+        *keys = ((struct ptrie_node16*)node)->keys;
+        *children = ((struct ptrie_node16*)node)->children;
+    }
+}
 
-        //free the string attach to an entry
-        if(node->entries[i].pointer != NULL){
-            free(node->entries[i].pointer);
-        }
+//the lowest character offset from `from` on whose bit is set in `present`, or -1
+static int next_present(const uint64_t* present, unsigned int from){
+    for(unsigned int w = from / 64; w < PTRIE_CHARS / 64; w++){
+        uint64_t bits = present[w];
 
-        //recurse to free the next node
-        if(node->entries[i].next != NULL){
-            recursive_free(node->entries[i].next);
+        if(w == from / 64){
+            bits &= ~0ULL << (from % 64);
+        }
+        if(bits != 0){
+            return w * 64 + __builtin_ctzll(bits);
         }
-        
     }
+    return -1;
+}
+
+//the rank a wide node keeps for a child: the rank of its best completion
+static double child_rank(struct ptrie_node* child){
+    return child->best == NULL ? -INFINITY : child->best->rank;
+}
+
+//updates the rank that the wide node `node` keeps for its child `child`, after
+//the child's best completion changed
+static void set_child_max(struct ptrie_node* node, struct ptrie_node* child){
+    unsigned char key = (unsigned char)ptrie_char2off(child->label[0]);
+
+    if(node->type == PTRIE_NODE48){
+        struct ptrie_node48* n48 = (struct ptrie_node48*)node;
+        n48->max[n48->index[key] - 1] = child_rank(child);
+    } else if(node->type == PTRIE_NODE256){
+        ((struct ptrie_node256*)node)->max[key] = child_rank(child);
+    }
+}
 
-    //free the node itself
-    free(node);
+//returns the child following position `*it` in character order and advances `*it`,
+//or NULL once every child was visited. Start iterating with `*it == 0`.
+static struct ptrie_node* next_child(struct ptrie_node* node, unsigned int* it){
+    switch(node->type){
+    case PTRIE_NODE4:
+    case PTRIE_NODE16: {
+        unsigned char* keys;
+        struct ptrie_node** children;
+
+        small_arrays(node, &keys, &children);
+        if(*it < node->nchildren){
+            return children[(*it)++];
+        }
+        return NULL;
+    }
+    case PTRIE_NODE48: {
+        struct ptrie_node48* n48 = (struct ptrie_node48*)node;
+        int c = next_present(n48->present, *it);
+        if(c < 0){
+            return NULL;
+        }
+        *it = c + 1;
+        return n48->children[n48->index[c] - 1];
+    }
+    case PTRIE_NODE256: {
+        struct ptrie_node256* n256 = (struct ptrie_node256*)node;
+        int c = next_present(n256->present, *it);
+        if(c < 0){
+            return NULL;
+        }
+        *it = c + 1;
+        return n256->children[c];
+    }
+    default:
+        return NULL;
+    }
 }
 
-//frees the ptrie 
+//frees the ptrie
 void ptrie_free(struct ptrie *pt){
-    //call recursive function on the root 
-    if(pt->root != NULL){
-        recursive_free(pt->root);
+    if(pt == NULL){
+        return;
+    }
+
+    //every node and key lives in the arena (or the frozen block), so this frees all of them
+    arena_destroy(pt->arena);
+    if(pt->mapping != NULL){
+        munmap(pt->mapping, pt->mapping_size);
+    } else{
+        free(pt->frozen);
     }
 
     //free the ptrie pointer itself
+    free(pt->path);
     free(pt);
 }
 
-//this creates a new ptrie node
-static struct ptrie_node* create_node(){
+//finds the child of a node whose label starts with `c`. Returns the slot holding
+//that child, so that the caller can replace it, or NULL if there is no such child.
+static struct ptrie_node** find_child(struct ptrie_node* node, char c){
+    unsigned char key = (unsigned char)ptrie_char2off(c);
+
+    switch(node->type){
+    case PTRIE_NODE4:
+    case PTRIE_NODE16: {
+        unsigned char* keys;
+        struct ptrie_node** children;
+
+        //the keys are sorted, so we can stop at the first larger one
+        small_arrays(node, &keys, &children);
+        for(unsigned int i = 0; i < node->nchildren && keys[i] <= key; i++){
+            if(keys[i] == key){
+                return &children[i];
+            }
+        }
+        return NULL;
+    }
+    case PTRIE_NODE48: {
+        struct ptrie_node48* n48 = (struct ptrie_node48*)node;
+        if(n48->index[key] == 0){
+            return NULL;
+        }
+        return &n48->children[n48->index[key] - 1];
+    }
+    case PTRIE_NODE256: {
+        struct ptrie_node256* n256 = (struct ptrie_node256*)node;
+        if(n256->children[key] == NULL){
+            return NULL;
+        }
+        return &n256->children[key];
+    }
+    default:
+        return NULL;
+    }
+}
 
-    //calloc a new node
-    struct ptrie_node* node = calloc(1, sizeof(struct ptrie_node));
+//moves the header and children of `node` into a fresh node of type `type`,
+//which must have room for them, frees the old one, and returns the new one
+static struct ptrie_node* resize_node(struct ptrie* pt, struct ptrie_node* node, unsigned char type){
+    struct ptrie_node* resized;
+    struct ptrie_node* child;
+    unsigned int it = 0;
+    unsigned int i = 0;
 
-    //sanity check
-    if(node == NULL){
+    resized = alloc_node(pt, type);
+    if(resized == NULL){
         return NULL;
     }
+    *resized = *node;
+    resized->type = type;
+
+    //copy the children over in character order
+    while((child = next_child(node, &it)) != NULL){
+        unsigned char key = (unsigned char)ptrie_char2off(child->label[0]);
+
+        switch(resized->type){
+        case PTRIE_NODE4:
+        case PTRIE_NODE16: {
+            unsigned char* keys;
+            struct ptrie_node** children;
+
+            small_arrays(resized, &keys, &children);
+            keys[i] = key;
+            children[i] = child;
+            break;
+        }
+        case PTRIE_NODE48: {
+            struct ptrie_node48* n48 = (struct ptrie_node48*)resized;
+            n48->children[i] = child;
+            n48->index[key] = i + 1;
+            n48->present[key / 64] |= 1ULL << (key % 64);
+            n48->max[i] = child_rank(child);
+            break;
+        }
+        case PTRIE_NODE256: {
+            struct ptrie_node256* n256 = (struct ptrie_node256*)resized;
+            n256->children[key] = child;
+            n256->present[key / 64] |= 1ULL << (key % 64);
+            n256->max[key] = child_rank(child);
+            break;
+        }
+        }
+        i++;
+    }
 
-    
+    free_node(pt, node);
+    return resized;
+}
 
-    //return the node itself
-    return node;
+//moves `node` into a node of the next larger size
+static struct ptrie_node* grow_node(struct ptrie* pt, struct ptrie_node* node){
+    return resize_node(pt, node, node->type + 1);
 }
 
-static void adjust_max(struct ptrie* pt, const char* str, int count){
-     if(pt == NULL || pt->root == NULL){
-        return;
+//inserts `child` under the node at `*ref`, growing the node (and updating `*ref`)
+//if it is full
+static int add_child(struct ptrie* pt, struct ptrie_node** ref, struct ptrie_node* child){
+    struct ptrie_node* node = *ref;
+    unsigned char key = (unsigned char)ptrie_char2off(child->label[0]);
+
+    //regrow into the next size if there is no free slot
+    if(node->type == PTRIE_NODE0 ||
+       (node->type == PTRIE_NODE4 && node->nchildren == 4) ||
+       (node->type == PTRIE_NODE16 && node->nchildren == 16) ||
+       (node->type == PTRIE_NODE48 && node->nchildren == 48)){
+        node = grow_node(pt, node);
+        if(node == NULL){
+            return -1;
+        }
+        *ref = node;
     }
 
-    //if given an invalid input
-    if(*str == '\0' || str == NULL){
-        return;
-    }
+    switch(node->type){
+    case PTRIE_NODE4:
+    case PTRIE_NODE16: {
+        unsigned char* keys;
+        struct ptrie_node** children;
+        unsigned int i;
 
+        small_arrays(node, &keys, &children);
 
-    //create a temp node
-    struct ptrie_node* temp_node = pt->root;
-    //iterate through the string
-    for(unsigned int i = 0; i < strlen(str); i++){
+        //shift the larger keys up to keep them sorted
+        for(i = node->nchildren; i > 0 && keys[i - 1] > key; i--){
+            keys[i] = keys[i - 1];
+            children[i] = children[i - 1];
+        }
+        keys[i] = key;
+        children[i] = child;
+        break;
+    }
+    case PTRIE_NODE48: {
+        struct ptrie_node48* n48 = (struct ptrie_node48*)node;
+        n48->children[node->nchildren] = child;
+        n48->index[key] = node->nchildren + 1;
+        n48->present[key / 64] |= 1ULL << (key % 64);
+        n48->max[node->nchildren] = child_rank(child);
+        break;
+    }
+    case PTRIE_NODE256: {
+        struct ptrie_node256* n256 = (struct ptrie_node256*)node;
+        n256->children[key] = child;
+        n256->present[key / 64] |= 1ULL << (key % 64);
+        n256->max[key] = child_rank(child);
+        break;
+    }
+    }
+    node->nchildren++;
 
-        //use the ascii value to get the index
-        int index = (int)str[i];
+    return 0;
+}
 
-        //if the index is invalid, there's some other issue as we cover every ascii value
-        if(index < 0 || index >= 256){
-            return;
+//removes the child whose label starts with `c` from the node at `*ref`, shrinking
+//the node (and updating `*ref`) once it is mostly empty
+static void remove_child(struct ptrie* pt, struct ptrie_node** ref, char c){
+    struct ptrie_node* node = *ref;
+    unsigned char key = (unsigned char)ptrie_char2off(c);
+    unsigned char smaller;
+
+    switch(node->type){
+    case PTRIE_NODE4:
+    case PTRIE_NODE16: {
+        unsigned char* keys;
+        struct ptrie_node** children;
+        unsigned int i = 0;
+
+        //shift the larger keys down to keep them sorted
+        small_arrays(node, &keys, &children);
+        while(keys[i] != key){
+            i++;
         }
-
-        //check for prior allocation issues before we do anything
-        if(temp_node == NULL){
-            return;
+        for(; i + 1 < node->nchildren; i++){
+            keys[i] = keys[i + 1];
+            children[i] = children[i + 1];
         }
-
-        temp_node->entries[index].max = count;
-
-        if(temp_node->entries[index].next != NULL){
-            temp_node = temp_node->entries[index].next;
+        break;
+    }
+    case PTRIE_NODE48: {
+        struct ptrie_node48* n48 = (struct ptrie_node48*)node;
+        unsigned int slot = n48->index[key] - 1;
+        unsigned int last = node->nchildren - 1;
+
+        //move the last child into the freed slot to keep the children packed
+        if(slot != last){
+            struct ptrie_node* moved = n48->children[last];
+            n48->children[slot] = moved;
+            n48->max[slot] = n48->max[last];
+            n48->index[(unsigned char)ptrie_char2off(moved->label[0])] = slot + 1;
+        }
+        n48->children[last] = NULL;
+        n48->index[key] = 0;
+        n48->present[key / 64] &= ~(1ULL << (key % 64));
+        break;
+    }
+    case PTRIE_NODE256: {
+        struct ptrie_node256* n256 = (struct ptrie_node256*)node;
+        n256->children[key] = NULL;
+        n256->present[key / 64] &= ~(1ULL << (key % 64));
+        n256->max[key] = -INFINITY;
+        break;
+    }
+    }
+    node->nchildren--;
+
+    //shrink well below the size the node was grown at, so that a node does
+    //not flip between two sizes as a child is added and removed
+    switch(node->type){
+    case PTRIE_NODE4:   smaller = node->nchildren == 0 ? PTRIE_NODE0 : PTRIE_NODE4; break;
+    case PTRIE_NODE16:  smaller = node->nchildren <= 3 ? PTRIE_NODE4 : PTRIE_NODE16; break;
+    case PTRIE_NODE48:  smaller = node->nchildren <= 12 ? PTRIE_NODE16 : PTRIE_NODE48; break;
+    default:            smaller = node->nchildren <= 37 ? PTRIE_NODE48 : PTRIE_NODE256; break;
+    }
+    if(smaller != node->type){
+        //if there is no memory for the smaller node, the larger one does just as well
+        struct ptrie_node* resized = resize_node(pt, node, smaller);
+        if(resized != NULL){
+            *ref = resized;
         }
     }
 }
 
-//given a tree and string, ptrie_add() the string to the ptrie, returns 0 for successful insertion
-//returns -1 for allocation issues
-int ptrie_add(struct ptrie *pt, const char *str){
+//splits the edge into the child at `*ref` after its first `at` characters,
+//returning the new node that sits in the middle of the old edge
+static struct ptrie_node* split_child(struct ptrie* pt, struct ptrie_node** ref, unsigned int at){
+    struct ptrie_node* child = *ref;
 
-    //if the tree or root is null, there was an allocation issue at ptrie_allocate()
-    if(pt == NULL || pt->root == NULL){
-        return -1;
+    //the middle node takes the shared start of the label
+    struct ptrie_node* mid = create_node(pt, PTRIE_NODE4);
+    if(mid == NULL){
+        return NULL;
     }
 
-    //if given an invalid input
-    if(*str == '\0' || str == NULL){
-        return -1;
+    //labels are never modified, so both halves keep pointing into the same bytes
+    mid->label = child->label;
+    mid->len = at;
+    child->label = child->label + at;
+    child->len = child->len - at;
+
+    //hang the old child below the middle node, which has room for it
+    add_child(pt, &mid, child);
+
+    //the middle node's subtree is exactly the old child's subtree
+    mid->best = child->best;
+    *ref = mid;
+
+    return mid;
+}
+
+//returns 1 if key `a` is a better completion than key `b`: it ranks higher, or
+//as high and it sorts first. `ptrie_char2off` keeps the character order, so the
+//tie-break is a plain string comparison.
+static int better(struct ptrie_key* a, struct ptrie_key* b){
+    if(b == NULL || a->rank > b->rank){
+        return 1;
     }
+    return a->rank == b->rank && strcmp(a->str, b->str) < 0;
+}
 
+//the current time in seconds
+static double ptrie_now(void){
+    struct timespec ts;
 
-    //create a temp node
-    struct ptrie_node* temp_node = pt->root;
-    //iterate through the string
-    for(unsigned int i = 0; i < strlen(str); i++){
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
-        //use the ascii value to get the index
-        int index = (int)str[i];
+//raises the rank of `key` for `count` more adds happening now. With a half-life,
+//each add weighs 2^(t / half-life): the weight of every earlier add relative to
+//it halves per half-life, without ever touching the other keys. The sum is
+//kept as a logarithm, so that it cannot overflow however far from the epoch.
+static void rank_add(struct ptrie* pt, struct ptrie_key* key, unsigned int count){
+    if(pt->halflife == 0){
+        key->rank = key->rank + count;
+        return;
+    }
 
-        //if the index is invalid, there's some other issue as we cover every ascii value
-        if(index < 0 || index >= 256){
-            return -1;
-        }
+    double weight = (ptrie_now() - pt->epoch) / pt->halflife + log2(count);
+    if(key->count == 0){
+        key->rank = weight;
+    } else{
+        double hi = fmax(key->rank, weight);
+        double lo = fmin(key->rank, weight);
+        key->rank = hi + log2(1 + exp2(lo - hi));
+    }
+}
 
-        //check for prior allocation issues before we do anything
-        if(temp_node == NULL){
+//pushes `node` onto the path stack of the key being added
+static int path_push(struct ptrie* pt, unsigned int depth, struct ptrie_node* node){
+    if(depth == pt->path_cap){
+        unsigned int cap = pt->path_cap == 0 ? 16 : pt->path_cap * 2;
+        struct ptrie_node** path = realloc(pt->path, cap * sizeof(struct ptrie_node*));
+
+        if(path == NULL){
             return -1;
         }
+        pt->path = path;
+        pt->path_cap = cap;
+    }
+    pt->path[depth] = node;
 
-        /*if this is the last character in the string, we append the string to the correct entry*/
-        if(str[i + 1] == '\0'){
-            //increase the correct entry count by 1
-            temp_node->entries[index].count = temp_node->entries[index].count + 1;
-            
+    return 0;
+}
 
-            //allocate space for the string in the correct entry
-            if(temp_node->entries[index].pointer == NULL){
-                temp_node->entries[index].pointer = malloc(128);
-            }
+//`key` was just added again; walk its path back up and make it the best
+//completion of every node it now beats. Ranks only ever grow, so once a node's
+//best is neither the key nor beaten by it, nothing above that node changes.
+static void update_best(struct ptrie* pt, unsigned int depth, struct ptrie_key* key){
+    for(unsigned int i = depth; i > 0; i--){
+        struct ptrie_node* ancestor = pt->path[i - 1];
 
-            //check for allocation issues
-            if(temp_node->entries[index].pointer == NULL){
-                return -1;
+        //the child on the path has the key as its best, whose rank grew
+        if(i < depth){
+            set_child_max(ancestor, pt->path[i]);
+        }
+        if(ancestor->best != key){
+            if(!better(key, ancestor->best)){
+                return;
             }
+            ancestor->best = key;
+        }
+    }
+}
 
-            //copy the string to the correct entry
-            strcpy(temp_node->entries[index].pointer, str);
+static int ptrie_thaw(struct ptrie* pt);
+static void evict(struct ptrie* pt);
 
-            //readjust the max to the highest count
-            if(temp_node->entries[index].count > temp_node->entries[index].max){
-                adjust_max(pt, str, temp_node->entries[index].count);
-            }
-        }
+//adds `str` to the ptrie `count` times
+static int add_count(struct ptrie* pt, const char* str, unsigned int count){
 
-        
+    //make sure every character is valid before touching the ptrie
+    unsigned int len = 0;
+    for(; str[len] != '\0'; len++){
+        if(ptrie_char2off(str[len]) < 0){
+            return -1;
+        }
+    }
 
-        //if the next node is empty
-        if(temp_node->entries[index].next == NULL){
+    //the slot that points to the node we are at, so that it can be regrown in place
+    struct ptrie_node** ref = &pt->root;
+    const char* rest = str;
+    unsigned int depth = 0;
+    struct ptrie_key* key = NULL;
+
+    //walk down the edges that match the string, splitting or adding as needed
+    while(*rest != '\0'){
+        struct ptrie_node** child_ref = find_child(*ref, *rest);
+
+        //no edge starts with this character, so the remainder becomes a new leaf
+        //whose label is the tail of the newly stored key
+        if(child_ref == NULL){
+            key = intern_key(pt, str, len);
+            if(key == NULL){
+                return -1;
+            }
+            //make room on the path for the parent and the leaf first, so that
+            //nothing can fail once the leaf is linked in without a count
+            struct ptrie_node* leaf = create_node(pt, PTRIE_NODE0);
+            if(leaf == NULL || path_push(pt, depth, *ref) != 0 || path_push(pt, depth + 1, NULL) != 0){
+                if(leaf != NULL){
+                    free_node(pt, leaf);
+                }
+                free_key(pt, key);
+                return -1;
+            }
+            leaf->label = key->str + (rest - str);
+            leaf->len = len - (rest - str);
+            if(add_child(pt, ref, leaf) != 0){
+                free_node(pt, leaf);
+                free_key(pt, key);
+                return -1;
+            }
+            //the parent, and the leaf's slot in it, may have moved if it was regrown
+            pt->path[depth++] = *ref;
+            ref = find_child(*ref, *rest);
+            rest += leaf->len;
+            break;
+        }
 
-            //create a new next for that entry
-            temp_node->entries[index].next = create_node();
+        //count how much of the edge label matches the string
+        struct ptrie_node* child = *child_ref;
+        unsigned int matched = 0;
+        while(matched < child->len && rest[matched] == child->label[matched]){
+            matched++;
+        }
 
-            //check for allocation issues
-            if(temp_node->entries[index].next == NULL){
+        //the string diverges from (or ends inside) the edge, so split it
+        if(matched < child->len){
+            if(split_child(pt, child_ref, matched) == NULL){
                 return -1;
             }
         }
 
         //iterate down a level in the tree
-        temp_node = temp_node->entries[index].next;
+        if(path_push(pt, depth++, *ref) != 0){
+            return -1;
+        }
+        ref = child_ref;
+        rest += matched;
+    }
+
+    //attach the string to the node it ends at
+    struct ptrie_node* temp_node = *ref;
+    if(path_push(pt, depth, temp_node) != 0){
+        return -1;
+    }
+    if(temp_node->key == NULL){
+        //the string ends inside existing labels, so it was not stored yet
+        if(key == NULL){
+            key = intern_key(pt, str, len);
+        }
 
-        
+        //check for allocation issues
+        if(key == NULL){
+            return -1;
+        }
+        temp_node->key = key;
     }
 
+    //increase the count and rank, and update the best completions above it
+    rank_add(pt, temp_node->key, count);
+    temp_node->key->count = temp_node->key->count + count;
+    update_best(pt, depth + 1, temp_node->key);
+
+    //the key is now the most recently added one
+    lru_unlink(pt, key_lru(temp_node->key));
+    lru_push(pt, key_lru(temp_node->key));
+
     //return 0 if we had no issues
     return 0;
-};
+}
 
+//given a tree and string, ptrie_add() the string to the ptrie, returns 0 for successful insertion
+//returns -1 for allocation issues
+int ptrie_add(struct ptrie *pt, const char *str){
 
+    //if the tree is null, there was an allocation issue at ptrie_allocate()
+    if(pt == NULL){
+        return -1;
+    }
 
+    //if given an invalid input
+    if(str == NULL || *str == '\0'){
+        return -1;
+    }
+    pt->version = next_version();
 
-//given a tree and string, ptrie_autocomplete will generate a completed string based on the incomplete
-//string given in th argument
-char *ptrie_autocomplete(struct ptrie *pt, const char *str){
+    //a frozen ptrie has to be turned back into nodes before it can change
+    if(pt->frozen != NULL && ptrie_thaw(pt) != 0){
+        return -1;
+    }
 
-    //iterate to the end of string
-    struct ptrie_node* temp_node =  pt->root;
+    if(add_count(pt, str, 1) != 0){
+        return -1;
+    }
 
-    //declare some variables to be used outside the for loop
-    size_t i = 0;
-    size_t compare = -1;
-    //intial traversal in the ptrie of the user input
-    for(i = 0; i < strlen(str) - 1; ++i){
+    //make room for the key by evicting others, if that took the ptrie over budget
+    evict(pt);
 
-        //edge case if the user gave us an empty string
-        if(strlen(str) - 1 == compare){
-            break;
-        }
+    return 0;
+}
 
-        //use the ascii value to get the index
-        int index = (int)str[i];
+//the nodes of a frozen ptrie, which follow its header
+static struct ptrie_fnode* frozen_nodes(struct ptrie_frozen* fz){
+    return (struct ptrie_fnode*)(fz + 1);
+}
 
-        //if the next node exists, traverse down a level in the ptrie
-        if(temp_node->entries[index].next != NULL){
-            temp_node = temp_node->entries[index].next;
-        }
-        //else the given input is not a prefix for any word in the ptrie 
-        else{
-            //return the user's input
-            return strdup(str);
-        }
-    }
+//the first character of each node's label, indexed like the nodes
+static const unsigned char* frozen_fchars(struct ptrie_frozen* fz){
+    return (const unsigned char*)fz + fz->fchars;
+}
 
-    //if the last letter has a string attached to it, and it's the highest count, return it
-    if(temp_node->entries[(int)str[i]].count == temp_node->entries[(int)str[i]].max && 
-    temp_node->entries[(int)str[i]].pointer != NULL){
-        return strdup(temp_node->entries[(int)str[i]].pointer);
-    }
+//the key or label at offset `off` in the keys area of a frozen ptrie
+static struct ptrie_key* frozen_key(struct ptrie_frozen* fz, uint32_t off){
+    return (struct ptrie_key*)((char*)fz + fz->keys + off);
+}
 
-    //iterate down another level
-    if(temp_node->entries[(int)str[i]].next != NULL){
-        temp_node = temp_node->entries[(int)str[i]].next;
-    } 
+static const char* frozen_label(struct ptrie_frozen* fz, struct ptrie_fnode* node){
+    return (const char*)fz + fz->keys + node->label;
+}
 
-    
-    //iterate through each entry in the node to find the alphabetically correct autocomplete
-    //entry
-    unsigned int largest_max = 0;
-    int largest_max_index = 0;
+//find_prefix for a frozen ptrie
+static struct ptrie_fnode* frozen_find_prefix(struct ptrie_frozen* fz, const char* str){
+    struct ptrie_fnode* nodes = frozen_nodes(fz);
+    const unsigned char* fchars = frozen_fchars(fz);
+    struct ptrie_fnode* temp_node = &nodes[0];
+    const char* rest = str;
 
-    //iterate through each entry to find the highest max
-    for(unsigned int i = 0; i < 256; i++){
+    while(*rest != '\0'){
+        //the children's first characters are contiguous and unique, so one memchr finds the edge
+        const unsigned char* hit = memchr(fchars + temp_node->child, (unsigned char)*rest, temp_node->nchildren);
 
-        //if its the highest max we have seen so far, save the index
-        if(temp_node->entries[i].max > largest_max){
-            largest_max = temp_node->entries[i].max;
-            largest_max_index = i;
+        if(hit == NULL){
+            return NULL;
         }
 
-        //on the last iteration take necessary actions
-        if(i == 255){
-            //if the highest max is also the highest count, return the string attached at that entry
-            if(temp_node->entries[largest_max_index].max == temp_node->entries[largest_max_index].count
-            && temp_node->entries[largest_max_index].pointer != NULL
-            && strlen(temp_node->entries[largest_max_index].pointer) != strlen(str)){
-                return strdup(temp_node->entries[largest_max_index].pointer);
-            }
-
-            //else if the largest max has a next pointer, traverse down a level
-            if(temp_node->entries[largest_max_index].next != NULL){
-                temp_node = temp_node->entries[largest_max_index].next;
-                largest_max = 0;
-                largest_max_index = 0;
-                i = 0;
-
+        //the input has to match the edge label until either of them ends
+        struct ptrie_fnode* child = &nodes[hit - fchars];
+        const char* label = frozen_label(fz, child);
+        unsigned int matched = 0;
+        while(matched < child->len && rest[matched] != '\0'){
+            if(rest[matched] != label[matched]){
+                return NULL;
             }
+            matched++;
         }
-        
+
+        temp_node = child;
+        rest += matched;
     }
 
-    //if we exit the loop, it means we found no autocompletable entry for the users input, so we
-    //return the users input
-    return strdup(str);
+    return temp_node;
 }
 
-//this is the recursive portion of the ptrie_print
-static void recursive_print(struct ptrie_node* node){
+//walks the ptrie along `str` and returns the highest node whose subtree holds
+//every key that has `str` as a prefix, or NULL if no key has that prefix
+static struct ptrie_node* find_prefix(struct ptrie* pt, const char* str){
+    struct ptrie_node* temp_node = pt->root;
+    const char* rest = str;
 
-    //iterate through the ptrie_node
-    for(unsigned int i = 0; i < 256; i++){
+    //intial traversal in the ptrie of the user input
+    while(*rest != '\0'){
+        struct ptrie_node** ref = find_child(temp_node, *rest);
 
-        //print out any entry we see
-        if(node->entries[i].pointer != NULL){
-            printf("%s \n\n", node->entries[i].pointer);
+        //the given input is not a prefix for any word in the ptrie
+        if(ref == NULL){
+            return NULL;
         }
 
-        //traverse down any next pointer we see
-        if(node->entries[i].next != NULL){
-            recursive_print(node->entries[i].next);
+        //the input has to match the edge label until either of them ends
+        struct ptrie_node* child = *ref;
+        unsigned int matched = 0;
+        while(matched < child->len && rest[matched] != '\0'){
+            if(rest[matched] != child->label[matched]){
+                return NULL;
+            }
+            matched++;
+        }
+
+        temp_node = child;
+        rest += matched;
+    }
+
+    return temp_node;
+}
+
+//returns the best completion of `str` without copying it, or NULL if there is none
+const char *ptrie_lookup(struct ptrie *pt, const char *str){
+    if(pt->frozen != NULL){
+        struct ptrie_fnode* fnode = frozen_find_prefix(pt->frozen, str);
+
+        if(fnode == NULL || fnode->best == PTRIE_FROZEN_NONE){
+            return NULL;
         }
+        return frozen_key(pt->frozen, fnode->best)->str;
+    }
+
+    struct ptrie_node* temp_node = find_prefix(pt, str);
+
+    if(temp_node == NULL || temp_node->best == NULL){
+        return NULL;
+    }
+
+    return temp_node->best->str;
+}
+
+//given a tree and string, ptrie_autocomplete will generate a completed string based on the incomplete
+//string given in th argument
+char *ptrie_autocomplete(struct ptrie *pt, const char *str){
+    const char* best = ptrie_lookup(pt, str);
+
+    //nothing with this prefix was ever added, return the user's input
+    if(best == NULL){
+        return strdup(str);
+    }
+
+    return strdup(best);
+}
+
+/*
+ * A cursor remembers where each prefix of the last string it looked up leads,
+ * so that the next lookup only walks the characters that differ: typing a
+ * character is one step down the ptrie, and deleting one is a step back.
+ */
+
+//a position in the ptrie: a node (a `struct ptrie_fnode` if the ptrie is
+//frozen), and how much of the label leading into it is matched. The node is
+//NULL if no key has the prefix.
+struct ptrie_cursor_pos{
+    void* node;
+    unsigned int matched;
+};
+
+struct ptrie_cursor{
+    //the ptrie walked, and its version at the time
+    struct ptrie* pt;
+    uint64_t version;
+
+    //the string walked, and where each of its prefixes leads: `pos[i]` is the
+    //position after its first `i` characters
+    char* str;
+    struct ptrie_cursor_pos* pos;
+    size_t len;
+    size_t cap;
+};
+
+struct ptrie_cursor *ptrie_cursor_allocate(void){
+    return calloc(1, sizeof(struct ptrie_cursor));
+}
+
+void ptrie_cursor_free(struct ptrie_cursor *c){
+    if(c == NULL){
+        return;
+    }
+    free(c->str);
+    free(c->pos);
+    free(c);
+}
+
+//makes room for the positions of a string of `len` characters
+static int cursor_reserve(struct ptrie_cursor* c, size_t len){
+    if(len < c->cap){
+        return 0;
+    }
+
+    size_t cap = c->cap == 0 ? 64 : c->cap;
+    while(cap <= len){
+        cap *= 2;
+    }
+    char* str = realloc(c->str, cap);
+    if(str == NULL){
+        return -1;
+    }
+    c->str = str;
+    struct ptrie_cursor_pos* pos = realloc(c->pos, cap * sizeof(struct ptrie_cursor_pos));
+    if(pos == NULL){
+        return -1;
+    }
+    c->pos = pos;
+    c->cap = cap;
+
+    return 0;
+}
+
+//the position one character `ch` further down from `pos`
+static struct ptrie_cursor_pos cursor_step(struct ptrie* pt, struct ptrie_cursor_pos pos, char ch){
+    struct ptrie_cursor_pos none = { NULL, 0 };
+
+    if(pos.node == NULL){
+        return none;
+    }
+    if(pt->frozen != NULL){
+        struct ptrie_fnode* fnode = pos.node;
+
+        //inside the label, the next character has to match it
+        if(pos.matched < fnode->len){
+            if(frozen_label(pt->frozen, fnode)[pos.matched] != ch){
+                return none;
+            }
+            pos.matched++;
+            return pos;
+        }
+
+        //at the end of it, the character picks the child
+        const unsigned char* fchars = frozen_fchars(pt->frozen);
+        const unsigned char* hit = memchr(fchars + fnode->child, (unsigned char)ch, fnode->nchildren);
+        if(hit == NULL){
+            return none;
+        }
+        pos.node = &frozen_nodes(pt->frozen)[hit - fchars];
+        pos.matched = 1;
+        return pos;
+    }
+
+    struct ptrie_node* node = pos.node;
+    if(pos.matched < node->len){
+        if(node->label[pos.matched] != ch){
+            return none;
+        }
+        pos.matched++;
+        return pos;
+    }
+    struct ptrie_node** ref = find_child(node, ch);
+    if(ref == NULL){
+        return none;
+    }
+    pos.node = *ref;
+    pos.matched = 1;
+    return pos;
+}
+
+//the best completion at a position, NULL if there is none
+static const char* cursor_best(struct ptrie* pt, struct ptrie_cursor_pos pos){
+    if(pos.node == NULL){
+        return NULL;
+    }
+    if(pt->frozen != NULL){
+        struct ptrie_fnode* fnode = pos.node;
+
+        return fnode->best == PTRIE_FROZEN_NONE ? NULL : frozen_key(pt->frozen, fnode->best)->str;
+    }
+
+    struct ptrie_node* node = pos.node;
+    return node->best == NULL ? NULL : node->best->str;
+}
+
+const char *ptrie_cursor_lookup(struct ptrie_cursor *c, struct ptrie *pt, const char *str){
+    size_t len = strlen(str);
+    size_t keep = 0;
+
+    //without a cursor, or room in it, this is a plain lookup
+    if(c == NULL || cursor_reserve(c, len) != 0){
+        return ptrie_lookup(pt, str);
+    }
+
+    //the positions of another ptrie, or of this one before it changed, are of no use
+    if(c->pt != pt || c->version != pt->version){
+        c->pt = pt;
+        c->version = pt->version;
+        c->len = 0;
+        c->pos[0].node = pt->frozen != NULL ? (void*)frozen_nodes(pt->frozen) : (void*)pt->root;
+        c->pos[0].matched = 0;
+    }
+
+    //step back to the longest prefix shared with the last string, then walk
+    //the rest of this one
+    while(keep < c->len && keep < len && c->str[keep] == str[keep]){
+        keep++;
+    }
+    for(c->len = keep; c->len < len; c->len++){
+        c->str[c->len] = str[c->len];
+        c->pos[c->len + 1] = cursor_step(pt, c->pos[c->len], str[c->len]);
+    }
+
+    return cursor_best(pt, c->pos[len]);
+}
+
+//the bounded heap used by ptrie_topk. It holds the best keys found so far with
+//the worst of them at the top, so that it is the one replaced by a better key.
+//It lives in the caller's output array, which holds the keys' strings.
+struct topk_heap{
+    const char** strs;
+    size_t n;
+    size_t k;
+};
+
+//the key that a string handed out by the ptrie belongs to
+static struct ptrie_key* str2key(const char* str){
+    return (struct ptrie_key*)(str - offsetof(struct ptrie_key, str));
+}
+
+//returns 1 if the key at heap position `a` is a better completion than the one at `b`
+static int heap_better(struct topk_heap* h, size_t a, size_t b){
+    return better(str2key(h->strs[a]), str2key(h->strs[b]));
+}
+
+//moves the key at `i` down the heap until both of its children are better
+static void heap_sift_down(struct topk_heap* h, size_t i){
+    while(1){
+        size_t worst = i;
+        size_t l = 2 * i + 1;
+        size_t r = 2 * i + 2;
+
+        if(l < h->n && heap_better(h, worst, l)){
+            worst = l;
+        }
+        if(r < h->n && heap_better(h, worst, r)){
+            worst = r;
+        }
+        if(worst == i){
+            return;
+        }
+
+        const char* tmp = h->strs[i];
+        h->strs[i] = h->strs[worst];
+        h->strs[worst] = tmp;
+        i = worst;
+    }
+}
+
+//offers a key to the heap, keeping it if it is among the k best seen so far
+static void heap_offer(struct topk_heap* h, struct ptrie_key* key){
+    //while the heap is not full, sift the key up from the bottom
+    if(h->n < h->k){
+        size_t i = h->n++;
+
+        while(i > 0 && better(str2key(h->strs[(i - 1) / 2]), key)){
+            h->strs[i] = h->strs[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        h->strs[i] = key->str;
+        return;
+    }
+
+    //otherwise it has to beat the worst key, which it then replaces
+    if(better(key, str2key(h->strs[0]))){
+        h->strs[0] = key->str;
+        heap_sift_down(h, 0);
+    }
+}
+
+//the recursive portion of ptrie_topk, offers every key in the subtree of `node`
+//to the heap, skipping subtrees whose best key cannot make it into the heap
+static void recursive_topk(struct ptrie_node* node, struct topk_heap* h){
+    struct ptrie_node* child;
+    unsigned int it = 0;
+
+    if(node->best == NULL || (h->n == h->k && !better(node->best, str2key(h->strs[0])))){
+        return;
+    }
+    if(node->key != NULL){
+        heap_offer(h, node->key);
+    }
+    while((child = next_child(node, &it)) != NULL){
+        recursive_topk(child, h);
+    }
+}
+
+//recursive_topk for a frozen ptrie
+static void frozen_topk(struct ptrie_frozen* fz, struct ptrie_fnode* node, struct topk_heap* h){
+    struct ptrie_fnode* nodes = frozen_nodes(fz);
+
+    if(node->best == PTRIE_FROZEN_NONE ||
+       (h->n == h->k && !better(frozen_key(fz, node->best), str2key(h->strs[0])))){
+        return;
+    }
+    if(node->key != PTRIE_FROZEN_NONE){
+        heap_offer(h, frozen_key(fz, node->key));
+    }
+    for(uint32_t i = 0; i < node->nchildren; i++){
+        frozen_topk(fz, &nodes[node->child + i], h);
+    }
+}
+
+//fills `out` with the (at most) `k` best completions of `str`, best first
+size_t ptrie_topk(struct ptrie *pt, const char *str, size_t k, const char **out){
+    struct topk_heap h = { .strs = out, .n = 0, .k = k };
+
+    if(k == 0){
+        return 0;
+    }
+    if(pt->frozen != NULL){
+        struct ptrie_fnode* fnode = frozen_find_prefix(pt->frozen, str);
+
+        if(fnode == NULL){
+            return 0;
+        }
+        frozen_topk(pt->frozen, fnode, &h);
+    } else{
+        struct ptrie_node* temp_node = find_prefix(pt, str);
+
+        if(temp_node == NULL){
+            return 0;
+        }
+        recursive_topk(temp_node, &h);
+    }
+
+    //swap the worst key to the back until the heap is empty, ordering the keys best first
+    size_t n = h.n;
+    while(h.n > 1){
+        const char* worst = h.strs[0];
+        h.strs[0] = h.strs[--h.n];
+        h.strs[h.n] = worst;
+        heap_sift_down(&h, 0);
+    }
+
+    return n;
+}
+
+//this is the recursive portion of the ptrie_print
+static void recursive_print(struct ptrie_node* node){
+
+    struct ptrie_node* child;
+    unsigned int it = 0;
+
+    //print out any entry we see
+    if(node->key != NULL){
+        printf("%s \n\n", node->key->str);
+    }
+
+    //traverse down each child in order
+    while((child = next_child(node, &it)) != NULL){
+        recursive_print(child);
     }
     return;
 }
 
 
 
+//recursive_print for a frozen ptrie
+static void frozen_print(struct ptrie_frozen* fz, struct ptrie_fnode* node){
+    if(node->key != PTRIE_FROZEN_NONE){
+        printf("%s \n\n", frozen_key(fz, node->key)->str);
+    }
+    for(uint32_t i = 0; i < node->nchildren; i++){
+        frozen_print(fz, &frozen_nodes(fz)[node->child + i]);
+    }
+}
+
 void ptrie_print(struct ptrie *pt){
-    for(unsigned int i = 0; i < 256; ++i){
-        if(pt->root->entries[i].next != NULL){
-            recursive_print(pt->root);
-        }
+    if(pt->frozen != NULL){
+        frozen_print(pt->frozen, frozen_nodes(pt->frozen));
+        return;
     }
+    recursive_print(pt->root);
     return;
 
 }
+
+//the function and argument ptrie_walk calls on every key
+struct walk_visitor{
+    void (*visit)(const char*, unsigned int, void*);
+    void* arg;
+};
+
+static void recursive_walk(struct ptrie_node* node, struct walk_visitor* v){
+    struct ptrie_node* child;
+    unsigned int it = 0;
+
+    if(node->key != NULL){
+        v->visit(node->key->str, node->key->count, v->arg);
+    }
+    while((child = next_child(node, &it)) != NULL){
+        recursive_walk(child, v);
+    }
+}
+
+static void frozen_walk(struct ptrie_frozen* fz, struct ptrie_fnode* node, struct walk_visitor* v){
+    if(node->key != PTRIE_FROZEN_NONE){
+        struct ptrie_key* key = frozen_key(fz, node->key);
+        v->visit(key->str, key->count, v->arg);
+    }
+    for(uint32_t i = 0; i < node->nchildren; i++){
+        frozen_walk(fz, &frozen_nodes(fz)[node->child + i], v);
+    }
+}
+
+void ptrie_walk(struct ptrie *pt, void (*visit)(const char *str, unsigned int count, void *arg), void *arg){
+    struct walk_visitor v = { .visit = visit, .arg = arg };
+
+    if(pt->frozen != NULL){
+        frozen_walk(pt->frozen, frozen_nodes(pt->frozen), &v);
+        return;
+    }
+    recursive_walk(pt->root, &v);
+}
+
+//the size of a key record, padded so that the next one is aligned
+static size_t key_size(unsigned int len){
+    size_t align = _Alignof(struct ptrie_key);
+
+    return (sizeof(struct ptrie_key) + len + 1 + align - 1) & ~(align - 1);
+}
+
+//counts the nodes in the subtree of `node`, and the bytes its keys take
+static void freeze_count(struct ptrie_node* node, uint32_t* nnodes, size_t* key_bytes){
+    struct ptrie_node* child;
+    unsigned int it = 0;
+
+    (*nnodes)++;
+    if(node->key != NULL){
+        *key_bytes += key_size(node->key->len);
+    }
+    while((child = next_child(node, &it)) != NULL){
+        freeze_count(child, nnodes, key_bytes);
+    }
+}
+
+//where ptrie_freeze puts the next group of children and the next key
+struct freeze_state{
+    struct ptrie_frozen* fz;
+    uint32_t next_node;
+    uint32_t next_key;
+};
+
+//copies `node`, whose label starts `depth` characters into its keys, into the
+//frozen slot `idx`, then its children into the next free group of slots
+static void freeze_node(struct freeze_state* st, struct ptrie_node* node, uint32_t idx, uint32_t depth){
+    struct ptrie_fnode* fnode = &frozen_nodes(st->fz)[idx];
+    unsigned char* fchars = (unsigned char*)st->fz + st->fz->fchars;
+    struct ptrie_node* child;
+    unsigned int it = 0;
+    uint32_t i = 0;
+
+    fnode->len = node->len;
+    fnode->key = PTRIE_FROZEN_NONE;
+    fnode->best = PTRIE_FROZEN_NONE;
+    fnode->child = st->next_node;
+    fnode->nchildren = node->nchildren;
+    st->next_node += node->nchildren;
+
+    //copy the key ending here
+    if(node->key != NULL){
+        fnode->key = st->next_key;
+        memcpy(frozen_key(st->fz, fnode->key), node->key, sizeof(struct ptrie_key) + node->key->len + 1);
+        st->next_key += key_size(node->key->len);
+        if(node->best == node->key){
+            fnode->best = fnode->key;
+        }
+    }
+
+    //then the children, picking up the frozen best key from the child that holds it
+    while((child = next_child(node, &it)) != NULL){
+        uint32_t child_idx = fnode->child + i++;
+
+        fchars[child_idx] = (unsigned char)child->label[0];
+        freeze_node(st, child, child_idx, depth + node->len);
+        if(child->best == node->best){
+            fnode->best = frozen_nodes(st->fz)[child_idx].best;
+        }
+    }
+
+    //every key in the subtree starts with the label, so it can point into the best one
+    if(fnode->best != PTRIE_FROZEN_NONE){
+        fnode->label = fnode->best + offsetof(struct ptrie_key, str) + depth;
+    }
+}
+
+//compacts the nodes of a modifiable ptrie into a new frozen block, leaving them
+//as they are. Returns NULL if the block could not be allocated.
+static struct ptrie_frozen* freeze_block(struct ptrie* pt){
+    uint32_t nnodes = 0;
+    size_t key_bytes = 0;
+
+    //size the block: header, nodes, first characters (padded), keys
+    freeze_count(pt->root, &nnodes, &key_bytes);
+    size_t fchars = sizeof(struct ptrie_frozen) + (size_t)nnodes * sizeof(struct ptrie_fnode);
+    size_t keys = (fchars + nnodes + _Alignof(struct ptrie_key) - 1) & ~(_Alignof(struct ptrie_key) - 1);
+    size_t size = keys + key_bytes;
+    if(size > UINT32_MAX){
+        return NULL;
+    }
+
+    struct ptrie_frozen* fz = malloc(size);
+    if(fz == NULL){
+        return NULL;
+    }
+    memset(fz, 0, size);
+    fz->size = size;
+    fz->nnodes = nnodes;
+    fz->fchars = fchars;
+    fz->keys = keys;
+
+    //the root takes the first slot
+    struct freeze_state st = { .fz = fz, .next_node = 1, .next_key = 0 };
+    freeze_node(&st, pt->root, 0, 0);
+
+    return fz;
+}
+
+int ptrie_freeze(struct ptrie *pt){
+    if(pt == NULL){
+        return -1;
+    }
+    if(pt->frozen != NULL){
+        return 0;
+    }
+
+    struct ptrie_frozen* fz = freeze_block(pt);
+    if(fz == NULL){
+        return -1;
+    }
+    pt->version = next_version();
+
+    //the mutable nodes are no longer needed
+    arena_destroy(pt->arena);
+    pt->arena = NULL;
+    pt->root = NULL;
+    free(pt->path);
+    pt->path = NULL;
+    pt->path_cap = 0;
+    pt->newest = NULL;
+    pt->oldest = NULL;
+    pt->nkeys = 0;
+    pt->nnodes = 0;
+    pt->bytes = 0;
+    pt->frozen = fz;
+
+    return 0;
+}
+
+struct ptrie *ptrie_snapshot(struct ptrie *pt){
+    struct ptrie* snap = calloc(1, sizeof(struct ptrie));
+
+    if(snap == NULL){
+        return NULL;
+    }
+    snap->version = next_version();
+
+    //a frozen ptrie is already a single block, that only needs copying
+    if(pt->frozen != NULL){
+        snap->frozen = malloc(pt->frozen->size);
+        if(snap->frozen != NULL){
+            memcpy(snap->frozen, pt->frozen, pt->frozen->size);
+        }
+    } else{
+        snap->frozen = freeze_block(pt);
+    }
+    if(snap->frozen == NULL){
+        free(snap);
+        return NULL;
+    }
+
+    //so that adding to the snapshot ranks keys like `pt` does
+    snap->halflife = pt->halflife;
+    snap->epoch = pt->epoch;
+
+    return snap;
+}
+
+/*
+ * A saved ptrie is a small header followed by the frozen block, exactly as it
+ * is laid out in memory, so that ptrie_load only has to map it.
+ */
+#define PTRIE_FILE_VERSION 2
+
+struct ptrie_file{
+    char magic[8];
+    uint32_t version;
+    uint32_t unused;
+    uint64_t stamp;
+};
+
+static const char ptrie_file_magic[8] = "mshptrie";
+
+int ptrie_save(struct ptrie *pt, const char *file, uint64_t stamp){
+    struct ptrie_file header = { .version = PTRIE_FILE_VERSION, .stamp = stamp };
+    char tmp[4096];
+    int fd;
+
+    if(ptrie_freeze(pt) != 0){
+        return -1;
+    }
+    memcpy(header.magic, ptrie_file_magic, sizeof(header.magic));
+
+    //write a temporary file and rename it, so that readers never see half a file
+    if(snprintf(tmp, sizeof(tmp), "%s.%d", file, (int)getpid()) >= (int)sizeof(tmp)){
+        return -1;
+    }
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0){
+        return -1;
+    }
+    if(write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+       write(fd, pt->frozen, pt->frozen->size) != (ssize_t)pt->frozen->size){
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
+    if(close(fd) != 0 || rename(tmp, file) != 0){
+        unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+//checks that the key record at offset `off` of the keys area, `key_bytes` long,
+//is aligned and inside of it, string and NUL included
+static int frozen_key_valid(struct ptrie_frozen* fz, uint64_t off, uint64_t key_bytes){
+    if(off % _Alignof(struct ptrie_key) != 0 || off + sizeof(struct ptrie_key) > key_bytes){
+        return 0;
+    }
+
+    struct ptrie_key* key = frozen_key(fz, off);
+    return off + key_size(key->len) <= key_bytes && key->str[key->len] == '\0';
+}
+
+//checks that `key` is not empty, holds only characters the ptrie allows, and
+//sorts strictly after `prev`, if there is one
+static int frozen_key_ordered(struct ptrie_key* prev, struct ptrie_key* key){
+    if(key->len == 0){
+        return 0;
+    }
+    for(unsigned int i = 0; i < key->len; i++){
+        if(ptrie_char2off(key->str[i]) < 0){
+            return 0;
+        }
+    }
+    if(prev == NULL){
+        return 1;
+    }
+
+    int cmp = memcmp(prev->str, key->str, prev->len < key->len ? prev->len : key->len);
+    return cmp < 0 || (cmp == 0 && prev->len < key->len);
+}
+
+//checks that every index and offset in a frozen block stays inside of it, so
+//that a truncated or corrupted file cannot make lookups read out of bounds.
+//Children have to come after their parent, so that walking the nodes ends, and
+//every key record has to fit, since thawing walks them by their lengths. Thawing
+//also builds the nodes back from the keys assuming they are sorted, distinct, and
+//made of allowed characters, as ptrie_save writes them.
+static int frozen_valid(struct ptrie_frozen* fz, size_t size){
+    if(fz->size != size || fz->nnodes == 0 ||
+       fz->fchars != sizeof(struct ptrie_frozen) + (uint64_t)fz->nnodes * sizeof(struct ptrie_fnode) ||
+       fz->keys < (uint64_t)fz->fchars + fz->nnodes || fz->keys > size ||
+       fz->keys % _Alignof(struct ptrie_key) != 0){
+        return 0;
+    }
+
+    uint64_t key_bytes = size - fz->keys;
+    struct ptrie_key* prev = NULL;
+    for(uint64_t off = 0; off < key_bytes; off += key_size(frozen_key(fz, off)->len)){
+        if(!frozen_key_valid(fz, off, key_bytes) || !frozen_key_ordered(prev, frozen_key(fz, off))){
+            return 0;
+        }
+        prev = frozen_key(fz, off);
+    }
+
+    struct ptrie_fnode* nodes = frozen_nodes(fz);
+    for(uint32_t i = 0; i < fz->nnodes; i++){
+        struct ptrie_fnode* node = &nodes[i];
+
+        if((uint64_t)node->child + node->nchildren > fz->nnodes ||
+           (node->nchildren > 0 && node->child <= i) ||
+           (uint64_t)node->label + node->len > key_bytes){
+            return 0;
+        }
+        if((node->key != PTRIE_FROZEN_NONE && !frozen_key_valid(fz, node->key, key_bytes)) ||
+           (node->best != PTRIE_FROZEN_NONE && !frozen_key_valid(fz, node->best, key_bytes))){
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+struct ptrie *ptrie_load(const char *file, uint64_t stamp){
+    struct ptrie_file* header;
+    struct ptrie* pt;
+    struct stat st;
+    void* map;
+    int fd;
+
+    fd = open(file, O_RDONLY);
+    if(fd < 0){
+        return NULL;
+    }
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size <= sizeof(struct ptrie_file) + sizeof(struct ptrie_frozen)){
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        return NULL;
+    }
+
+    //only use the file if it is ours, and was saved for the same stamp
+    header = map;
+    if(memcmp(header->magic, ptrie_file_magic, sizeof(header->magic)) != 0 ||
+       header->version != PTRIE_FILE_VERSION || header->stamp != stamp ||
+       !frozen_valid((struct ptrie_frozen*)(header + 1), st.st_size - sizeof(struct ptrie_file))){
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    pt = calloc(1, sizeof(struct ptrie));
+    if(pt == NULL){
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    pt->version = next_version();
+    pt->frozen = (struct ptrie_frozen*)(header + 1);
+    pt->mapping = map;
+    pt->mapping_size = st.st_size;
+
+    return pt;
+}
+
+//the smallest node type with room for `nchildren` children
+static unsigned char node_type_for(unsigned int nchildren){
+    if(nchildren == 0){
+        return PTRIE_NODE0;
+    } else if(nchildren <= 4){
+        return PTRIE_NODE4;
+    } else if(nchildren <= 16){
+        return PTRIE_NODE16;
+    } else if(nchildren <= 48){
+        return PTRIE_NODE48;
+    }
+    return PTRIE_NODE256;
+}
+
+//the number of children of a node whose label ends `depth` characters into the
+//`n` sorted, distinct `keys` that all go through it: one per run of keys
+//sharing the next character. A key ending at the node is not counted.
+static unsigned int count_runs(struct ptrie_key** keys, size_t n, unsigned int depth){
+    unsigned int nchildren = 0;
+
+    for(size_t i = 0; i < n; i++){
+        if(keys[i]->len > depth && (i == 0 || keys[i]->str[depth] != keys[i - 1]->str[depth])){
+            nchildren++;
+        }
+    }
+    return nchildren;
+}
+
+static struct ptrie_node* build_subtree(struct ptrie* pt, struct ptrie_key** keys, size_t n, unsigned int depth);
+
+//fills in `node`, whose label ends `depth` characters into the `n` sorted,
+//distinct `keys` that all go through it: its key if one of them ends here,
+//then a child for each run of keys sharing the next character. The node must
+//already be large enough for all of its children.
+static int build_children(struct ptrie* pt, struct ptrie_node* node, struct ptrie_key** keys, size_t n, unsigned int depth){
+    //a key ending here sorts before every longer key
+    if(n > 0 && keys[0]->len == depth){
+        node->key = keys[0];
+        node->best = keys[0];
+        keys++;
+        n--;
+    }
+
+    //build each run into a child, whose best may become the node's
+    for(size_t i = 0; i < n;){
+        size_t j = i + 1;
+        while(j < n && keys[j]->str[depth] == keys[i]->str[depth]){
+            j++;
+        }
+
+        //the children come in key order, so on a tie the best found so far sorts first
+        struct ptrie_node* child = build_subtree(pt, keys + i, j - i, depth);
+        if(child == NULL || add_child(pt, &node, child) != 0){
+            return -1;
+        }
+        if(node->best == NULL || child->best->rank > node->best->rank){
+            node->best = child->best;
+        }
+        i = j;
+    }
+
+    return 0;
+}
+
+//builds the subtree of the `n` sorted, distinct `keys`, which share their first
+//`depth` characters and the character after them. Its edge label runs to the end
+//of the longest prefix all of them share.
+static struct ptrie_node* build_subtree(struct ptrie* pt, struct ptrie_key** keys, size_t n, unsigned int depth){
+    struct ptrie_key* first = keys[0];
+    struct ptrie_key* last = keys[n - 1];
+    unsigned int lcp = depth + 1;
+
+    //the keys are sorted, so the prefix shared by the first and last is shared by all
+    while(lcp < first->len && first->str[lcp] == last->str[lcp]){
+        lcp++;
+    }
+
+    //a single key is a leaf, and needs no counting
+    unsigned char type = n == 1 ? PTRIE_NODE0 : node_type_for(count_runs(keys, n, lcp));
+    struct ptrie_node* node = create_node(pt, type);
+    if(node == NULL){
+        return NULL;
+    }
+    node->label = first->str + depth;
+    node->len = lcp - depth;
+    if(build_children(pt, node, keys, n, lcp) != 0){
+        return NULL;
+    }
+
+    return node;
+}
+
+//builds the nodes of `pt` from the `n` sorted, distinct `keys`, replacing its root
+static int build_root(struct ptrie* pt, struct ptrie_key** keys, size_t n){
+    struct ptrie_node* root = create_node(pt, node_type_for(count_runs(keys, n, 0)));
+
+    if(root == NULL){
+        return -1;
+    }
+    free_node(pt, pt->root);
+    pt->root = root;
+
+    return build_children(pt, root, keys, n, 0);
+}
+
+//a range of strings still to be sorted, which are equal up to `depth`
+struct bulk_range{
+    size_t lo;
+    size_t hi;
+    unsigned int depth;
+};
+
+//sorts short ranges, where distributing them into 128 buckets does not pay off
+static void bulk_insertion_sort(const char** strs, size_t n, unsigned int depth){
+    for(size_t i = 1; i < n; i++){
+        const char* str = strs[i];
+        size_t j = i;
+
+        while(j > 0 && strcmp(strs[j - 1] + depth, str + depth) > 0){
+            strs[j] = strs[j - 1];
+            j--;
+        }
+        strs[j] = str;
+    }
+}
+
+//sorts `n` valid strings with a most-significant-digit radix sort: the strings
+//are distributed into buckets by the character at the range's depth, and each
+//bucket is sorted by the next character. Each character is read once per level
+//instead of once per comparison. `ptrie_char2off` keeps the character order,
+//so the result is in plain string order.
+static int bulk_radix_sort(const char** strs, size_t n){
+    const char** aux = malloc((n + 1) * sizeof(const char*));
+    unsigned char* chars = malloc(n + 1);
+    struct bulk_range* stack = malloc(16 * sizeof(struct bulk_range));
+    size_t nstack = 0;
+    size_t cap = 16;
+
+    if(aux == NULL || chars == NULL || stack == NULL){
+        free(aux);
+        free(chars);
+        free(stack);
+        return -1;
+    }
+    stack[nstack++] = (struct bulk_range){ .lo = 0, .hi = n, .depth = 0 };
+
+    while(nstack > 0){
+        struct bulk_range r = stack[--nstack];
+        size_t count[128] = { 0 };
+        size_t start[128];
+
+        if(r.hi - r.lo < 16){
+            bulk_insertion_sort(strs + r.lo, r.hi - r.lo, r.depth);
+            continue;
+        }
+
+        //count the bucket sizes, then move every string to its bucket
+        for(size_t i = r.lo; i < r.hi; i++){
+            chars[i] = (unsigned char)strs[i][r.depth];
+            count[chars[i]]++;
+        }
+        start[0] = r.lo;
+        for(int c = 1; c < 128; c++){
+            start[c] = start[c - 1] + count[c - 1];
+        }
+        for(size_t i = r.lo; i < r.hi; i++){
+            aux[start[chars[i]]++] = strs[i];
+        }
+        memcpy(strs + r.lo, aux + r.lo, (r.hi - r.lo) * sizeof(const char*));
+
+        //the strings in bucket 0 ended and are all equal, the others need the
+        //next character sorted
+        for(int c = 1; c < 128; c++){
+            if(count[c] < 2){
+                continue;
+            }
+            if(nstack == cap){
+                struct bulk_range* bigger = realloc(stack, 2 * cap * sizeof(struct bulk_range));
+                if(bigger == NULL){
+                    free(aux);
+                    free(chars);
+                    free(stack);
+                    return -1;
+                }
+                stack = bigger;
+                cap *= 2;
+            }
+            stack[nstack++] = (struct bulk_range){ .lo = start[c] - count[c], .hi = start[c], .depth = r.depth + 1 };
+        }
+    }
+    free(aux);
+    free(chars);
+    free(stack);
+
+    return 0;
+}
+
+//sorts the valid strings among `keys`, leaving out those ptrie_add would
+//reject, and stores each distinct one once in `pt` with its number of
+//duplicates as its count. Returns the stored keys in order, or NULL.
+static struct ptrie_key** bulk_sort(struct ptrie* pt, const char** keys, size_t n, size_t* ndistinct){
+    const char** sorted = malloc((n + 1) * sizeof(const char*));
+    struct ptrie_key** distinct = malloc((n + 1) * sizeof(struct ptrie_key*));
+    size_t nsorted = 0;
+
+    if(sorted == NULL || distinct == NULL){
+        free(sorted);
+        free(distinct);
+        return NULL;
+    }
+    for(size_t i = 0; i < n; i++){
+        const char* c = keys[i];
+
+        if(c == NULL || *c == '\0'){
+            continue;
+        }
+        while(*c != '\0' && ptrie_char2off(*c) >= 0){
+            c++;
+        }
+        if(*c == '\0'){
+            sorted[nsorted++] = keys[i];
+        }
+    }
+    if(bulk_radix_sort(sorted, nsorted) != 0){
+        free(sorted);
+        free(distinct);
+        return NULL;
+    }
+
+    //duplicates are next to each other once sorted
+    *ndistinct = 0;
+    for(size_t i = 0; i < nsorted;){
+        size_t j = i + 1;
+        while(j < nsorted && strcmp(sorted[j], sorted[i]) == 0){
+            j++;
+        }
+
+        struct ptrie_key* key = intern_key(pt, sorted[i], strlen(sorted[i]));
+        if(key == NULL){
+            free(sorted);
+            free(distinct);
+            return NULL;
+        }
+        key->count = j - i;
+        key->rank = j - i;
+        distinct[(*ndistinct)++] = key;
+        i = j;
+    }
+    free(sorted);
+
+    return distinct;
+}
+
+struct ptrie *ptrie_build_bulk(const char **keys, size_t n){
+    struct ptrie* pt = ptrie_allocate();
+    struct ptrie_key** distinct;
+    size_t ndistinct;
+
+    if(pt == NULL){
+        return NULL;
+    }
+
+    //with the keys sorted, every subtree is a contiguous run of them, so the
+    //ptrie is built in one pass from the root, each node sized right away
+    distinct = bulk_sort(pt, keys, n, &ndistinct);
+    if(distinct == NULL || build_root(pt, distinct, ndistinct) != 0){
+        free(distinct);
+        ptrie_free(pt);
+        return NULL;
+    }
+    free(distinct);
+
+    return pt;
+}
+
+//turns a frozen ptrie back into nodes. Its keys are laid out in depth-first
+//order, which is sorted order, so the nodes are built in one pass like in
+//ptrie_build_bulk, into a new ptrie whose nodes this one then takes over.
+static int ptrie_thaw(struct ptrie* pt){
+    struct ptrie_frozen* fz = pt->frozen;
+    struct ptrie* thawed = ptrie_allocate();
+    struct ptrie_key** keys = malloc(((fz->size - fz->keys) / sizeof(struct ptrie_key) + 1) * sizeof(struct ptrie_key*));
+    size_t n = 0;
+
+    if(thawed == NULL || keys == NULL){
+        ptrie_free(thawed);
+        free(keys);
+        return -1;
+    }
+
+    //the keys area holds nothing but the key records, back to back
+    for(size_t off = 0; fz->keys + off < fz->size; off += key_size(frozen_key(fz, off)->len)){
+        struct ptrie_key* key = frozen_key(fz, off);
+
+        keys[n] = intern_key(thawed, key->str, key->len);
+        if(keys[n] == NULL){
+            ptrie_free(thawed);
+            free(keys);
+            return -1;
+        }
+        keys[n]->rank = key->rank;
+        keys[n++]->count = key->count;
+    }
+    if(build_root(thawed, keys, n) != 0){
+        ptrie_free(thawed);
+        free(keys);
+        return -1;
+    }
+    free(keys);
+
+    if(pt->mapping != NULL){
+        munmap(pt->mapping, pt->mapping_size);
+    } else{
+        free(fz);
+    }
+    pt->frozen = NULL;
+    pt->mapping = NULL;
+    pt->mapping_size = 0;
+
+    pt->root = thawed->root;
+    pt->arena = thawed->arena;
+    memcpy(pt->slabs, thawed->slabs, sizeof(pt->slabs));
+    memcpy(pt->key_slabs, thawed->key_slabs, sizeof(pt->key_slabs));
+    free(pt->path);
+    pt->path = thawed->path;
+    pt->path_cap = thawed->path_cap;
+    pt->newest = thawed->newest;
+    pt->oldest = thawed->oldest;
+    pt->nkeys = thawed->nkeys;
+    pt->nnodes = thawed->nnodes;
+    pt->bytes = thawed->bytes;
+    free(thawed);
+
+    return 0;
+}
+
+//the best completion in the subtree of `node`, from its own key and the best
+//completions of its children
+static struct ptrie_key* subtree_best(struct ptrie_node* node){
+    struct ptrie_key* best = node->key;
+    struct ptrie_node* child = NULL;
+    unsigned int it = 0;
+
+    if(node->nchildren == 0){
+        return best;
+    }
+    switch(node->type){
+    case PTRIE_NODE48: {
+        //the highest rank, and then the lowest character holding it, as slots are not in character order
+        struct ptrie_node48* n48 = (struct ptrie_node48*)node;
+        double max = n48->max[argmax(n48->max, node->nchildren)];
+        int c = next_present(n48->present, 0);
+
+        while(n48->max[n48->index[c] - 1] != max){
+            c = next_present(n48->present, c + 1);
+        }
+        child = n48->children[n48->index[c] - 1];
+        break;
+    }
+    case PTRIE_NODE256: {
+        //the lowest index holding the highest rank is the lowest character, and
+        //the scan can start at the first child
+        struct ptrie_node256* n256 = (struct ptrie_node256*)node;
+        int lo = next_present(n256->present, 0);
+
+        child = n256->children[lo + argmax(n256->max + lo, PTRIE_CHARS - lo)];
+        break;
+    }
+    default:
+        while((child = next_child(node, &it)) != NULL){
+            if(child->best != NULL && better(child->best, best)){
+                best = child->best;
+            }
+        }
+        return best;
+    }
+
+    if(child->best != NULL && better(child->best, best)){
+        best = child->best;
+    }
+    return best;
+}
+
+//the slot that points to the `i`th node on the path stack
+static struct ptrie_node** path_ref(struct ptrie* pt, unsigned int i){
+    if(i == 0){
+        return &pt->root;
+    }
+    return find_child(pt->path[i - 1], pt->path[i]->label[0]);
+}
+
+//removes `str` from the modifiable ptrie `pt` once, or altogether if `all` is set
+static int remove_key(struct ptrie* pt, const char* str, int all){
+    //walk down to the node the string ends at, recording the path
+    struct ptrie_node* temp_node = pt->root;
+    const char* rest = str;
+    unsigned int depth = 0;
+
+    if(path_push(pt, depth++, temp_node) != 0){
+        return -1;
+    }
+    while(*rest != '\0'){
+        struct ptrie_node** ref = find_child(temp_node, *rest);
+
+        if(ref == NULL){
+            return -1;
+        }
+
+        //the whole edge label has to match, the string cannot end inside it
+        struct ptrie_node* child = *ref;
+        for(unsigned int matched = 0; matched < child->len; matched++){
+            if(rest[matched] != child->label[matched]){
+                return -1;
+            }
+        }
+
+        temp_node = child;
+        rest += child->len;
+        if(path_push(pt, depth++, temp_node) != 0){
+            return -1;
+        }
+    }
+
+    struct ptrie_key* key = temp_node->key;
+    if(key == NULL){
+        return -1;
+    }
+
+    //decrease the count, dropping the key once it reaches zero. With a half-life,
+    //the rank loses an average add's worth.
+    if(!all && key->count > 1){
+        key->rank = pt->halflife == 0 ? key->rank - 1 : key->rank + log2((key->count - 1) / (double)key->count);
+    }
+    key->count = all ? 0 : key->count - 1;
+    if(key->count == 0){
+        temp_node->key = NULL;
+    }
+
+    //walk back up, fixing the structure and the best completions. `end` is how
+    //far into the key the label of the node at `i` ends.
+    unsigned int end = key->len;
+    for(unsigned int i = depth - 1; i > 0; i--){
+        struct ptrie_node* node = pt->path[i];
+        unsigned int start = end - node->len;
+
+        if(node->key == NULL && node->nchildren == 0){
+            //the node holds nothing anymore, take it out of its parent
+            struct ptrie_node** parent_ref = path_ref(pt, i - 1);
+
+            remove_child(pt, parent_ref, node->label[0]);
+            pt->path[i - 1] = *parent_ref;
+            free_node(pt, node);
+        } else if(node->key == NULL && node->nchildren == 1){
+            //the node no longer branches, merge it into its only child. The
+            //merged label is a slice of a key in the child's subtree.
+            unsigned int it = 0;
+            struct ptrie_node* child = next_child(node, &it);
+
+            child->label = child->best->str + start;
+            child->len = child->len + node->len;
+            *path_ref(pt, i) = child;
+            set_child_max(pt->path[i - 1], child);
+            free_node(pt, node);
+        } else{
+            //with the key still there, only the nodes it was the best of
+            //change, and they are all on the path up from here
+            if(node->best != key){
+                if(key->count > 0){
+                    return 0;
+                }
+            } else{
+                node->best = subtree_best(node);
+            }
+
+            //a removed key's bytes should not be referenced anymore
+            if(key->count == 0 && node->label >= key->str && node->label < key->str + key->len){
+                node->label = node->best->str + start;
+            }
+            set_child_max(pt->path[i - 1], node);
+        }
+        end = start;
+    }
+    if(pt->root->best == key){
+        pt->root->best = subtree_best(pt->root);
+    }
+
+    //nothing refers to the key anymore
+    if(key->count == 0){
+        free_key(pt, key);
+    }
+
+    return 0;
+}
+
+int ptrie_remove(struct ptrie *pt, const char *str){
+    if(pt == NULL || str == NULL || *str == '\0'){
+        return -1;
+    }
+    pt->version = next_version();
+    if(pt->frozen != NULL && ptrie_thaw(pt) != 0){
+        return -1;
+    }
+
+    return remove_key(pt, str, 0);
+}
+
+//evicts keys until the ptrie is within its budget, always keeping the most
+//recently added key. Among the PTRIE_EVICT_WINDOW least recently added keys,
+//the lowest ranked one goes first, and the older one of those on a tie.
+static void evict(struct ptrie* pt){
+    while(pt->budget != 0 && pt->bytes > pt->budget && pt->nkeys > 1){
+        struct ptrie_lru* victim = pt->oldest;
+        struct ptrie_lru* lru = victim->newer;
+
+        for(unsigned int i = 1; i < PTRIE_EVICT_WINDOW && lru != pt->newest; i++){
+            if(lru_key(lru)->rank < lru_key(victim)->rank){
+                victim = lru;
+            }
+            lru = lru->newer;
+        }
+        if(pt->evicted != NULL){
+            pt->evicted(lru_key(victim)->str, pt->evicted_arg);
+        }
+        if(remove_key(pt, lru_key(victim)->str, 1) != 0){
+            return;
+        }
+    }
+}
+
+void ptrie_set_evicted(struct ptrie *pt, void (*evicted)(const char *str, void *arg), void *arg){
+    pt->evicted = evicted;
+    pt->evicted_arg = arg;
+}
+
+void ptrie_set_budget(struct ptrie *pt, size_t bytes){
+    pt->budget = bytes;
+    if(pt->frozen == NULL){
+        pt->version = next_version();
+        evict(pt);
+    }
+}
+
+void ptrie_stats(struct ptrie *pt, struct ptrie_stats *stats){
+    struct ptrie_frozen* fz = pt->frozen;
+
+    stats->budget = pt->budget;
+    if(fz != NULL){
+        //the frozen block is all there is, count its keys
+        stats->keys = 0;
+        for(size_t off = 0; fz->keys + off < fz->size; off += key_size(frozen_key(fz, off)->len)){
+            stats->keys++;
+        }
+        stats->nodes = fz->nnodes;
+        stats->bytes = fz->size;
+        stats->reserved = pt->mapping != NULL ? pt->mapping_size : fz->size;
+        return;
+    }
+    stats->keys = pt->nkeys;
+    stats->nodes = pt->nnodes;
+    stats->bytes = pt->bytes;
+    stats->reserved = arena_mapped(pt->arena);
+}
+
+unsigned int ptrie_count(struct ptrie *pt, const char *str){
+    size_t len = strlen(str);
+
+    //the key ending at the node the prefix leads to is the string itself only
+    //if it is exactly as long
+    if(pt->frozen != NULL){
+        struct ptrie_fnode* fnode = frozen_find_prefix(pt->frozen, str);
+
+        if(fnode == NULL || fnode->key == PTRIE_FROZEN_NONE || frozen_key(pt->frozen, fnode->key)->len != len){
+            return 0;
+        }
+        return frozen_key(pt->frozen, fnode->key)->count;
+    }
+
+    struct ptrie_node* temp_node = find_prefix(pt, str);
+
+    if(temp_node == NULL || temp_node->key == NULL || temp_node->key->len != len){
+        return 0;
+    }
+    return temp_node->key->count;
+}
+
+double ptrie_rank(struct ptrie *pt, const char *str){
+    size_t len = strlen(str);
+
+    //like ptrie_count, the key has to be exactly as long as the string
+    if(pt->frozen != NULL){
+        struct ptrie_fnode* fnode = frozen_find_prefix(pt->frozen, str);
+
+        if(fnode == NULL || fnode->key == PTRIE_FROZEN_NONE || frozen_key(pt->frozen, fnode->key)->len != len){
+            return -INFINITY;
+        }
+        return frozen_key(pt->frozen, fnode->key)->rank;
+    }
+
+    struct ptrie_node* temp_node = find_prefix(pt, str);
+
+    if(temp_node == NULL || temp_node->key == NULL || temp_node->key->len != len){
+        return -INFINITY;
+    }
+    return temp_node->key->rank;
+}
+
+int ptrie_set_halflife(struct ptrie *pt, double seconds){
+    //ranks with and without a half-life are not comparable
+    if(pt->frozen != NULL || pt->nkeys > 0 || seconds < 0){
+        return -1;
+    }
+    pt->halflife = seconds;
+    pt->epoch = ptrie_now();
+
+    return 0;
+}
+
+/*
+ * A shared ptrie is the latest snapshot published by its writer. Readers use
+ * whichever snapshot was current when they entered, and a replaced snapshot is
+ * freed through the epoch once no reader can still be using it.
+ */
+struct ptrie_shared{
+    _Atomic(struct ptrie*) current;
+    struct epoch* epoch;
+};
+
+struct ptrie_shared *ptrie_shared_allocate(void){
+    struct ptrie_shared* sh = malloc(sizeof(struct ptrie_shared));
+
+    if(sh == NULL){
+        return NULL;
+    }
+    sh->epoch = epoch_create();
+    if(sh->epoch == NULL){
+        free(sh);
+        return NULL;
+    }
+    atomic_init(&sh->current, NULL);
+
+    return sh;
+}
+
+void ptrie_shared_free(struct ptrie_shared *sh){
+    if(sh == NULL){
+        return;
+    }
+    ptrie_free(atomic_load(&sh->current));
+    epoch_destroy(sh->epoch);
+    free(sh);
+}
+
+//the destructor of retired snapshots
+static void shared_release(void* pt){
+    ptrie_free(pt);
+}
+
+int ptrie_shared_publish(struct ptrie_shared *sh, struct ptrie *pt){
+    struct ptrie* snap = ptrie_snapshot(pt);
+
+    if(snap == NULL){
+        return -1;
+    }
+
+    //readers that entered before the swap may still use the old snapshot
+    struct ptrie* old = atomic_exchange(&sh->current, snap);
+    if(old != NULL){
+        epoch_retire(sh->epoch, old, shared_release);
+    }
+
+    return 0;
+}
+
+int ptrie_shared_register(struct ptrie_shared *sh){
+    return epoch_register(sh->epoch);
+}
+
+void ptrie_shared_unregister(struct ptrie_shared *sh, int reader){
+    epoch_unregister(sh->epoch, reader);
+}
+
+struct ptrie *ptrie_shared_enter(struct ptrie_shared *sh, int reader){
+    epoch_enter(sh->epoch, reader);
+    return atomic_load(&sh->current);
+}
+
+void ptrie_shared_exit(struct ptrie_shared *sh, int reader){
+    epoch_exit(sh->epoch, reader);
+}
+
+uint64_t ptrie_version(struct ptrie *pt){
+    return pt->version;
+}
@@ -1,6 +1,9 @@
 #ifndef PTRIE_H
 #define PTRIE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /***
  * The prefix trie enables you to add strings that are tracked by the
  * data-structure, and to autocomplete to get the most-frequently
@@ -55,12 +58,78 @@ void ptrie_free(struct ptrie *pt);
  *     the `str` could not be added due to `malloc` failure, or if the
  *     string has invalid characters (ascii values < 32, see
  *     https://upload.wikimedia.org/wikipedia/commons/1/1b/ASCII-Table-wide.svg).
+ *
+ * If `pt` is frozen (see `ptrie_freeze`), it is first copied back
+ * into its modifiable form, which costs about as much as adding every
+ * string again.
  */
 int ptrie_add(struct ptrie *pt, const char *str);
 
+/**
+ * `ptrie_remove` is the inverse of `ptrie_add`: it decreases the
+ * count of a string by one, and removes the string from the ptrie
+ * once its count reaches zero. The completions of every prefix of
+ * the string are updated accordingly. A frozen `pt` is copied back
+ * into its modifiable form first, as in `ptrie_add`.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to remove the string from.
+ * - `@str` - The string to remove, *borrowed* from the caller.
+ * - `@return` - `0` upon success, `-1` if `str` was never added (or
+ *     was already removed as often as it was added), or on `malloc`
+ *     failure.
+ */
+int ptrie_remove(struct ptrie *pt, const char *str);
+
+/**
+ * `ptrie_count` returns how many times a string was added (minus the
+ * times it was removed).
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to search.
+ * - `@str` - The exact string to look for.
+ * - `@return` - The count of `str`, `0` if it is not in the ptrie.
+ */
+unsigned int ptrie_count(struct ptrie *pt, const char *str);
+
+/**
+ * `ptrie_rank` returns what completions of a string are ranked by:
+ * its count, or with a half-life its frecency (see
+ * `ptrie_set_halflife`). A higher rank is suggested first, so this
+ * lets other indexes of the same strings order them the same way.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to search.
+ * - `@str` - The exact string to look for.
+ * - `@return` - The rank of `str`, `-INFINITY` if it is not in the
+ *     ptrie.
+ */
+double ptrie_rank(struct ptrie *pt, const char *str);
+
+/**
+ * `ptrie_build_bulk` creates a ptrie holding many strings at once.
+ * The result is the same as calling `ptrie_add` on a new ptrie for
+ * each of them, but it is built in a single pass over the sorted
+ * strings instead, which is much faster for thousands of strings.
+ *
+ * Arguments:
+ *
+ * - `@keys` - The strings to add, in any order, *borrowed* from the
+ *     caller. A string that appears several times is counted as many
+ *     times. Strings that `ptrie_add` would reject are left out.
+ * - `@n` - The number of strings in `keys`.
+ * - `@return` - The new ptrie, or `NULL` if it could not be
+ *     allocated.
+ */
+struct ptrie *ptrie_build_bulk(const char **keys, size_t n);
+
 /**
  * `ptrie_autocomplete` provides an autocompletion for a given string,
- * driven by the frequency of the addition of various strings. It
+ * driven by the frequency of the addition of various strings (or
+ * their frecency, see `ptrie_set_halflife`). It
  * returns the string that has been added the most for which `str` is
  * its prefix. Return a copy of `str` if no such strings have `str` as
  * a prefix. If two strings with an *equal* frequency of addition have
@@ -86,6 +155,295 @@ int ptrie_add(struct ptrie *pt, const char *str);
  */
 char *ptrie_autocomplete(struct ptrie *pt, const char *str);
 
+/**
+ * `ptrie_lookup` is the allocation-free version of
+ * `ptrie_autocomplete`, for callers on hot paths such as per-keystroke
+ * hints. It finds the same completion, but does not copy it.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to search.
+ * - `@str` - The prefix to complete.
+ * - `@return` - The completion, *borrowed* from the ptrie: it is valid
+ *     until the next `ptrie_add`, `ptrie_remove` or `ptrie_free` on
+ *     `pt`, and must not be freed by the caller. `NULL` if no string
+ *     with the prefix `str` was added.
+ */
+const char *ptrie_lookup(struct ptrie *pt, const char *str);
+
+/**
+ * A `ptrie_cursor` speeds up looking up one string after another when
+ * each differs from the last only at its end, as a line being typed
+ * does. It remembers where each prefix of the last string led in the
+ * ptrie, so that a lookup only walks the characters that changed:
+ * typing a character takes one step down, and deleting one takes a
+ * step back, however long the string is.
+ */
+struct ptrie_cursor;
+
+/**
+ * `ptrie_cursor_allocate` allocates a new cursor, `NULL` if it could
+ * not be, and `ptrie_cursor_free` frees it.
+ */
+struct ptrie_cursor *ptrie_cursor_allocate(void);
+void ptrie_cursor_free(struct ptrie_cursor *c);
+
+/**
+ * `ptrie_cursor_lookup` finds the same completion as `ptrie_lookup`.
+ * If `pt` did not change since the last lookup with `c`, it starts
+ * from the longest prefix `str` shares with the string looked up then;
+ * otherwise it starts over from the root.
+ *
+ * Arguments:
+ *
+ * - `@c` - The cursor, or `NULL` for a plain `ptrie_lookup`.
+ * - `@pt` - The ptrie to search.
+ * - `@str` - The prefix to complete.
+ * - `@return` - The completion, *borrowed* as in `ptrie_lookup`, or
+ *     `NULL` if no string with the prefix `str` was added.
+ */
+const char *ptrie_cursor_lookup(struct ptrie_cursor *c, struct ptrie *pt, const char *str);
+
+/**
+ * `ptrie_topk` finds the `k` best completions for a given string in a
+ * single traversal of the ptrie. They are ranked the same way as in
+ * `ptrie_autocomplete`: by frequency (or frecency) of addition, then
+ * by lower `ptrie_char2off` value.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to search.
+ * - `@str` - The prefix that every returned completion starts with.
+ * - `@k` - The maximum number of completions to return.
+ * - `@out` - An array of at least `k` entries that is filled with the
+ *     completions, best first. The strings are *borrowed* from the
+ *     ptrie: they are valid until the next `ptrie_add`,
+ *     `ptrie_remove` or `ptrie_free` on `pt`, and must not be freed
+ *     by the caller.
+ * - `@return` - The number of completions placed in `out`, `0` if no
+ *     string with the prefix `str` was added.
+ */
+size_t ptrie_topk(struct ptrie *pt, const char *str, size_t k, const char **out);
+
+/**
+ * `ptrie_freeze` turns `pt` into a read-only ptrie, for ptries that
+ * are built once and then only queried. The ptrie is compacted into a
+ * single contiguous block, with the best completion of each prefix
+ * precomputed, so that lookups touch few cache lines.
+ *
+ * Every other operation works on a frozen ptrie as before, but
+ * `ptrie_add` and `ptrie_remove` first have to copy it back into its
+ * modifiable form.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to freeze.
+ * - `@return` - `0` on success, `-1` if the block could not be
+ *     allocated, in which case `pt` is left unfrozen.
+ */
+int ptrie_freeze(struct ptrie *pt);
+
+/**
+ * `ptrie_snapshot` returns a frozen copy of `pt` (see `ptrie_freeze`),
+ * leaving `pt` as it is.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to copy.
+ * - `@return` - The copy, to free with `ptrie_free`, or `NULL` if it
+ *     could not be allocated.
+ */
+struct ptrie *ptrie_snapshot(struct ptrie *pt);
+
+/**
+ * `ptrie_save` stores `pt` in a file, so that a later run can load it
+ * with `ptrie_load` instead of rebuilding it. `pt` is frozen first if
+ * it is not already (see `ptrie_freeze`).
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to save.
+ * - `@file` - The path of the file, which is replaced atomically.
+ * - `@stamp` - A value identifying what the ptrie was built from (for
+ *     example a hash of its inputs), that `ptrie_load` checks.
+ * - `@return` - `0` on success, `-1` if the file could not be written.
+ */
+int ptrie_save(struct ptrie *pt, const char *file, uint64_t stamp);
+
+/**
+ * `ptrie_load` maps a file written by `ptrie_save` read-only into
+ * memory and returns it as a frozen ptrie. Nothing is copied, so this
+ * is fast regardless of the size of the ptrie. `ptrie_free` unmaps it.
+ *
+ * Arguments:
+ *
+ * - `@file` - The path of the file.
+ * - `@stamp` - The stamp the file must have been saved with.
+ * - `@return` - The ptrie, or `NULL` if the file does not exist, is
+ *     not a valid saved ptrie, or was saved with a different stamp.
+ */
+struct ptrie *ptrie_load(const char *file, uint64_t stamp);
+
+/**
+ * A `ptrie_shared` lets other threads query a ptrie while one writer
+ * thread keeps changing it. The writer updates its own ptrie, and
+ * publishes a snapshot of it whenever the readers should see the
+ * changes. Readers never block or take a lock: they always query the
+ * latest snapshot published when they started, and a replaced snapshot
+ * is only freed once every reader that might be using it is done.
+ *
+ * ```c
+ * // writer                          // reader
+ * ptrie_add(pt, "ls");               int r = ptrie_shared_register(sh);
+ * ptrie_shared_publish(sh, pt);      struct ptrie *snap = ptrie_shared_enter(sh, r);
+ *                                    if(snap != NULL) ptrie_lookup(snap, "l");
+ *                                    ptrie_shared_exit(sh, r);
+ * ```
+ */
+struct ptrie_shared;
+
+/**
+ * `ptrie_shared_allocate` allocates a shared ptrie with no snapshot
+ * published yet, and `ptrie_shared_free` frees it along with every
+ * snapshot. No reader may be between `ptrie_shared_enter` and
+ * `ptrie_shared_exit` when it is freed.
+ *
+ * - `@return` - The shared ptrie, or `NULL` if it could not be
+ *     allocated.
+ */
+struct ptrie_shared *ptrie_shared_allocate(void);
+void ptrie_shared_free(struct ptrie_shared *sh);
+
+/**
+ * `ptrie_shared_publish` makes a snapshot of `pt` (see
+ * `ptrie_snapshot`) the one that readers entering from now on use.
+ * Only one thread, the writer, may publish to `sh`. Publishing copies
+ * the whole ptrie, so a writer making many changes at once should
+ * publish once they are all made.
+ *
+ * Arguments:
+ *
+ * - `@sh` - The shared ptrie.
+ * - `@pt` - The writer's ptrie, which stays the writer's.
+ * - `@return` - `0` on success, `-1` if the snapshot could not be
+ *     allocated, in which case the readers keep the previous one.
+ */
+int ptrie_shared_publish(struct ptrie_shared *sh, struct ptrie *pt);
+
+/**
+ * `ptrie_shared_register` reserves a slot for a reader thread, which
+ * it then passes to `ptrie_shared_enter` and `ptrie_shared_exit`;
+ * `ptrie_shared_unregister` gives it back. A slot may only be used by
+ * one thread at a time.
+ *
+ * - `@return` - The slot, or `-1` if too many readers are registered.
+ */
+int ptrie_shared_register(struct ptrie_shared *sh);
+void ptrie_shared_unregister(struct ptrie_shared *sh, int reader);
+
+/**
+ * `ptrie_shared_enter` returns the latest snapshot published to `sh`,
+ * or `NULL` if there is none yet. It can be queried with every
+ * function that does not change a ptrie, and is valid, along with the
+ * strings borrowed from it, until `ptrie_shared_exit`.
+ *
+ * Arguments:
+ *
+ * - `@sh` - The shared ptrie.
+ * - `@reader` - The slot of the calling reader.
+ */
+struct ptrie *ptrie_shared_enter(struct ptrie_shared *sh, int reader);
+void ptrie_shared_exit(struct ptrie_shared *sh, int reader);
+
+/**
+ * `ptrie_walk` calls `visit` on every string in `pt`, in
+ * `ptrie_char2off` order, with the number of times it was added.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to walk, which `visit` must not change.
+ * - `@visit` - Called with each string, *borrowed* from the ptrie for
+ *     the duration of the call, its count, and `arg`.
+ * - `@arg` - Passed on to `visit`.
+ */
+void ptrie_walk(struct ptrie *pt, void (*visit)(const char *str, unsigned int count, void *arg), void *arg);
+
+/**
+ * `ptrie_version` returns a value that changes whenever `pt` might
+ * have changed, so that callers can tell when to recompute what they
+ * derived from it. Versions are never shared between ptries, even
+ * between one that was freed and one allocated in its place.
+ */
+uint64_t ptrie_version(struct ptrie *pt);
+
+/**
+ * `ptrie_set_halflife` ranks the strings of `pt` by frecency instead
+ * of frequency: every addition of a string counts for half as much
+ * per `seconds` elapsed since, so that a string added often recently
+ * beats one added more often long ago. Ties are still broken by lower
+ * `ptrie_char2off` value. Adding a string stays as cheap as without a
+ * half-life.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie, which must be empty and not frozen.
+ * - `@seconds` - The half-life, or `0` to rank by plain frequency
+ *     (the default).
+ * - `@return` - `0` on success, `-1` if `pt` already holds strings.
+ */
+int ptrie_set_halflife(struct ptrie *pt, double seconds);
+
+/**
+ * `ptrie_set_budget` bounds the memory used by the strings and nodes
+ * of `pt`. Whenever adding a string takes the ptrie over its budget,
+ * other strings are evicted until it is back under it: among the
+ * least recently added strings, the least frequently added ones go
+ * first. The string just added is never evicted.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie to bound.
+ * - `@bytes` - The budget in bytes, or `0` for no limit (the
+ *     default). A lower budget than the current footprint evicts
+ *     right away.
+ */
+void ptrie_set_budget(struct ptrie *pt, size_t bytes);
+
+/**
+ * `ptrie_set_evicted` sets a function to call with every string that
+ * the budget evicts (see `ptrie_set_budget`), so that what is kept
+ * alongside the ptrie can be dropped with it.
+ *
+ * Arguments:
+ *
+ * - `@pt` - The ptrie.
+ * - `@evicted` - Called with each string just before it is evicted,
+ *     along with `arg`. The string is *borrowed* for the call only.
+ *     It must not change `pt`. `NULL` to stop calling one.
+ * - `@arg` - Passed along to `evicted`.
+ */
+void ptrie_set_evicted(struct ptrie *pt, void (*evicted)(const char *str, void *arg), void *arg);
+
+/**
+ * The footprint of a ptrie, as reported by `ptrie_stats`.
+ */
+struct ptrie_stats {
+    /* number of distinct strings, and of nodes holding them */
+    size_t keys;
+    size_t nodes;
+    /* bytes used by the strings and nodes, which `budget` bounds */
+    size_t bytes;
+    /* bytes reserved from the system, including freed memory kept for reuse */
+    size_t reserved;
+    /* the budget set with `ptrie_set_budget`, `0` if none */
+    size_t budget;
+};
+
+/**
+ * `ptrie_stats` reports the current footprint of `pt` in `stats`.
+ */
+void ptrie_stats(struct ptrie *pt, struct ptrie_stats *stats);
+
 /**
  * `ptrie_print` is a utility function that you are *not* required to
  * implement, but that is quite useful for debugging. It is easiest to
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <sunit.h>
+#include <argmax.h>
+
+/* as in a ptrie's widest nodes: a rank per character, -INFINITY where none is present */
+#define CHARS  128
+#define ROUNDS 2000
+
+/* fills `max` for a random `present` bitmap, with few distinct ranks so that they tie */
+static void
+random_max(double *max, uint64_t *present)
+{
+	int c, density = rand() % 4;
+
+	present[0] = present[1] = 0;
+	for (c = 0; c < CHARS; c++) {
+		max[c] = -INFINITY;
+		if (density > 0 && rand() % 4 < density) {
+			present[c / 64] |= 1ULL << (c % 64);
+			max[c] = rand() % 5 - 2 + (rand() % 2 ? 0.5 : 0);
+		}
+	}
+}
+
+/* the lowest present character, where ptrie starts its scan, 0 for an empty bitmap */
+static int
+first_present(const uint64_t *present)
+{
+	if (present[0] != 0) return __builtin_ctzll(present[0]);
+	if (present[1] != 0) return 64 + __builtin_ctzll(present[1]);
+	return 0;
+}
+
+sunit_ret_t
+test_kernels(void)
+{
+	argmax_fn scalar = argmax_kernel_at(0), kernel;
+	double max[CHARS];
+	uint64_t present[2];
+	size_t i, n, expect;
+	int round, lo;
+
+	SUNIT_ASSERT("scalar", scalar != NULL);
+	srand(15);
+	for (round = 0; round < ROUNDS; round++) {
+		random_max(max, present);
+		lo = first_present(present);
+		for (i = 0; (kernel = argmax_kernel_at(i)) != NULL; i++) {
+			/* from the first present character, as ptrie does, and every other length */
+			SUNIT_ASSERT("from the first", kernel(max + lo, CHARS - lo) == scalar(max + lo, CHARS - lo));
+			for (n = 1; n <= CHARS; n++) {
+				expect = scalar(max, n);
+				SUNIT_ASSERT("lowest of the largest", kernel(max, n) == expect);
+				SUNIT_ASSERT("offset", kernel(max + CHARS - n, n) == scalar(max + CHARS - n, n));
+			}
+		}
+		SUNIT_ASSERT("argmax", argmax(max + lo, CHARS - lo) == scalar(max + lo, CHARS - lo));
+	}
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_edges(void)
+{
+	double none[CHARS], ties[CHARS];
+	argmax_fn kernel;
+	size_t i, c;
+
+	for (c = 0; c < CHARS; c++) {
+		none[c] = -INFINITY;
+		ties[c] = c % 7 == 3 ? 1 : 0;
+	}
+	for (i = 0; (kernel = argmax_kernel_at(i)) != NULL; i++) {
+		/* nothing present is a tie of every slot, the first one wins */
+		SUNIT_ASSERT("empty bitmap", kernel(none, CHARS) == 0);
+		SUNIT_ASSERT("one", kernel(none, 1) == 0);
+		SUNIT_ASSERT("ties", kernel(ties, CHARS) == 3 && kernel(ties + 4, CHARS - 4) == 6);
+		ties[CHARS - 1] = 2;
+		SUNIT_ASSERT("in the tail", kernel(ties, CHARS) == CHARS - 1 && kernel(ties, CHARS - 1) == 3);
+		ties[CHARS - 1] = 0;
+	}
+	SUNIT_ASSERT("past the last", argmax_kernel_at(i + 1) == NULL);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("argmax kernels agree with the plain loop", test_kernels),
+		SUNIT_TEST("argmax kernels on empty and tied arrays", test_edges),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Finding the largest rank", tests);
+
+	return 0;
+}
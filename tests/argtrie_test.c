@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sunit.h>
+#include <argtrie.h>
+
+sunit_ret_t
+test_add(void)
+{
+	struct argtrie *at = argtrie_allocate();
+	char *checkout[] = { "git", "checkout", "main", NULL };
+	char *commit[] = { "git", "commit", "-m", NULL };
+	char *bad[] = { "git", "caf\xc3\xa9", "", "--amend", NULL };
+	const char *out[4];
+
+	SUNIT_ASSERT("allocate", at != NULL);
+	SUNIT_ASSERT("add", argtrie_add(at, checkout) == 0 && argtrie_add(at, checkout) == 0);
+	SUNIT_ASSERT("add", argtrie_add(at, commit) == 0);
+	SUNIT_ASSERT("topk", argtrie_topk(at, "git", 1, "c", 4, out) == 2 && strcmp(out[0], "checkout") == 0);
+	SUNIT_ASSERT("position", argtrie_topk(at, "git", 2, "", 4, out) == 2);
+	SUNIT_ASSERT("other program", argtrie_topk(at, "hg", 1, "", 4, out) == 0);
+
+	/* the arguments a ptrie cannot hold are skipped, not those after them */
+	SUNIT_ASSERT("add bad", argtrie_add(at, bad) == -1);
+	SUNIT_ASSERT("skipped", argtrie_topk(at, "git", 1, "caf", 4, out) == 0);
+	SUNIT_ASSERT("after the skipped", argtrie_topk(at, "git", 3, "--", 4, out) == 1 && strcmp(out[0], "--amend") == 0);
+	argtrie_free(at);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_max_programs(void)
+{
+	struct argtrie *at = argtrie_allocate();
+	char *make[] = { "make", "test", NULL };
+	char *ls[] = { "ls", "-la", NULL };
+	char *prog[] = { NULL, "--help", NULL };
+	const char *out[4];
+	char name[16];
+	int i;
+
+	SUNIT_ASSERT("allocate", at != NULL);
+	argtrie_set_max_programs(at, 4);
+	for (i = 0; i < 3; i++) SUNIT_ASSERT("add frequent", argtrie_add(at, make) == 0);
+	SUNIT_ASSERT("add", argtrie_add(at, ls) == 0 && argtrie_add(at, ls) == 0);
+
+	/* many programs run once only ever evict each other */
+	for (i = 0; i < 100; i++) {
+		snprintf(name, sizeof(name), "prog%d", i);
+		prog[0] = name;
+		SUNIT_ASSERT("add rare", argtrie_add(at, prog) == 0);
+		SUNIT_ASSERT("newest kept", argtrie_topk(at, name, 1, "", 4, out) == 1);
+	}
+	SUNIT_ASSERT("frequent kept", argtrie_topk(at, "make", 1, "", 4, out) == 1 && argtrie_topk(at, "ls", 1, "", 4, out) == 1);
+	SUNIT_ASSERT("previous kept", argtrie_topk(at, "prog98", 1, "", 4, out) == 1);
+	SUNIT_ASSERT("oldest evicted", argtrie_topk(at, "prog0", 1, "", 4, out) == 0 && argtrie_bytes(at, "prog97") == 0);
+
+	/* lowering the cap evicts right away, the least used first */
+	argtrie_set_max_programs(at, 1);
+	SUNIT_ASSERT("most used left", argtrie_topk(at, "make", 1, "", 4, out) == 1);
+	SUNIT_ASSERT("others evicted", argtrie_bytes(at, "ls") == 0 && argtrie_bytes(at, "prog99") == 0);
+	argtrie_free(at);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_bytes(void)
+{
+	struct argtrie *at = argtrie_allocate();
+	char *args[] = { "cc", "-O2", "-Wall", "-c", "x.c", NULL };
+	size_t bytes;
+
+	SUNIT_ASSERT("allocate", at != NULL);
+	SUNIT_ASSERT("empty", argtrie_bytes(at, "cc") == 0);
+	SUNIT_ASSERT("add", argtrie_add(at, args) == 0);
+
+	/* four positions, each with what its ptrie reserved, far more than the strings */
+	bytes = argtrie_bytes(at, "cc");
+	SUNIT_ASSERT("reserved", bytes >= 4 * 4096);
+	SUNIT_ASSERT("total", argtrie_bytes(at, NULL) > bytes);
+	argtrie_free(at);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("argtrie add", test_add),
+		SUNIT_TEST("argtrie evicts the least used programs", test_max_programs),
+		SUNIT_TEST("argtrie reports reserved bytes", test_bytes),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Learning arguments by program", tests);
+
+	return 0;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sunit.h>
+#include <fuzzy.h>
+
+sunit_ret_t
+test_match(void)
+{
+	struct fuzzy *fz = fuzzy_allocate();
+	const char *out[4];
+
+	SUNIT_ASSERT("allocate", fz != NULL);
+	SUNIT_ASSERT("add", fuzzy_add(fz, "git checkout main") == 0 && fuzzy_add(fz, "grep -c ok") == 0);
+	SUNIT_ASSERT("add", fuzzy_add(fz, "ls") == 0);
+	SUNIT_ASSERT("match", fuzzy_match(fz, "gco", 4, out) == 2 && strcmp(out[0], "ls") != 0 && strcmp(out[1], "ls") != 0);
+	SUNIT_ASSERT("best match", fuzzy_match(fz, "gchm", 4, out) == 1 && strcmp(out[0], "git checkout main") == 0);
+	SUNIT_ASSERT("no match", fuzzy_match(fz, "zz", 4, out) == 0);
+	SUNIT_ASSERT("empty pattern", fuzzy_match(fz, "", 4, out) == 0);
+	fuzzy_free(fz);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_remove(void)
+{
+	struct fuzzy *fz = fuzzy_allocate();
+	const char *out[4];
+
+	SUNIT_ASSERT("allocate", fz != NULL);
+
+	/* a candidate added twice is matched once, and stays until removed twice */
+	SUNIT_ASSERT("add", fuzzy_add(fz, "make test") == 0 && fuzzy_add(fz, "make test") == 0);
+	SUNIT_ASSERT("add", fuzzy_add(fz, "mkdir src") == 0);
+	SUNIT_ASSERT("counted once", fuzzy_match(fz, "mt", 4, out) == 1);
+	SUNIT_ASSERT("remove", fuzzy_remove(fz, "make test") == 0 && fuzzy_match(fz, "mt", 4, out) == 1);
+	SUNIT_ASSERT("remove", fuzzy_remove(fz, "make test") == 0 && fuzzy_match(fz, "mt", 4, out) == 0);
+	SUNIT_ASSERT("removed too often", fuzzy_remove(fz, "make test") == -1);
+	SUNIT_ASSERT("never added", fuzzy_remove(fz, "make") == -1);
+	SUNIT_ASSERT("others kept", fuzzy_match(fz, "mds", 4, out) == 1 && strcmp(out[0], "mkdir src") == 0);
+
+	/* and it comes back */
+	SUNIT_ASSERT("re-add", fuzzy_add(fz, "make test") == 0 && fuzzy_match(fz, "mt", 4, out) == 1);
+	SUNIT_ASSERT("re-added", strcmp(out[0], "make test") == 0);
+
+	/* clearing forgets everything */
+	fuzzy_clear(fz);
+	SUNIT_ASSERT("cleared", fuzzy_match(fz, "m", 4, out) == 0 && fuzzy_remove(fz, "make test") == -1);
+	fuzzy_free(fz);
+
+	return SUNIT_SUCCESS;
+}
+
+#define NSTRS 200
+#define NOPS  20000
+
+/* adds and removes at random, so that candidates are compacted many times */
+sunit_ret_t
+test_remove_random(void)
+{
+	struct fuzzy *fz = fuzzy_allocate();
+	unsigned int refs[NSTRS] = { 0 };
+	const char *out[NSTRS];
+	char str[32], pattern[8];
+	size_t n, expect;
+	int i, op;
+
+	SUNIT_ASSERT("allocate", fz != NULL);
+	srand(3);
+	for (op = 0; op < NOPS; op++) {
+		i = rand() % NSTRS;
+		snprintf(str, sizeof(str), "cmd-%03d --flag", i);
+		if (rand() % 2) {
+			SUNIT_ASSERT("add", fuzzy_add(fz, str) == 0);
+			refs[i]++;
+		} else {
+			SUNIT_ASSERT("remove", fuzzy_remove(fz, str) == (refs[i] > 0 ? 0 : -1));
+			if (refs[i] > 0) refs[i]--;
+		}
+
+		/* every candidate there matches its own number, the others do not */
+		snprintf(pattern, sizeof(pattern), "-%03d ", i);
+		n = fuzzy_match(fz, pattern, NSTRS, out);
+		SUNIT_ASSERT("match", n == (refs[i] > 0));
+		SUNIT_ASSERT("match string", n == 0 || strcmp(out[0], str) == 0);
+	}
+	for (i = 0, expect = 0; i < NSTRS; i++) expect += refs[i] > 0;
+	SUNIT_ASSERT("all", fuzzy_match(fz, "cmd", NSTRS, out) == expect);
+	fuzzy_free(fz);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("fuzzy match", test_match),
+		SUNIT_TEST("fuzzy remove", test_remove),
+		SUNIT_TEST("fuzzy add and remove at random", test_remove_random),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Fuzzy matching", tests);
+
+	return 0;
+}
@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sunit.h>
+#include <msh.h>
+#include <msh_parse.h>
+
+/* whether the args of `c` are the words of `expect`, separated by spaces */
+static int
+args_are(struct msh_command *c, const char *expect)
+{
+	char **args = msh_command_args(c);
+	char buf[256];
+	size_t i;
+
+	buf[0] = '\0';
+	for (i = 0; args[i] != NULL; i++) {
+		if (i > 0) strcat(buf, " ");
+		strcat(buf, args[i]);
+	}
+
+	return strcmp(buf, expect) == 0;
+}
+
+/* parses `str` into `s`, and frees its pipelines, returning the allocations it took */
+static size_t
+parse_allocations(const char *str, struct msh_sequence *s)
+{
+	size_t before = msh_parse_allocations();
+	struct msh_pipeline *p;
+	static char line[8192];
+
+	if (strlen(str) >= sizeof(line)) return (size_t)-1;
+	strcpy(line, str);
+	if (msh_sequence_parse(line, s) != 0) return (size_t)-1;
+	while ((p = msh_sequence_pipeline(s)) != NULL) msh_pipeline_free(p);
+	msh_sequence_reset(s);
+
+	return msh_parse_allocations() - before;
+}
+
+/* this runs first, while nothing is pooled yet */
+sunit_ret_t
+test_allocations(void)
+{
+	size_t before = msh_parse_allocations();
+	struct msh_sequence *s = msh_sequence_alloc();
+
+	SUNIT_ASSERT("allocate", s != NULL);
+	SUNIT_ASSERT("a sequence takes one", msh_parse_allocations() - before == 1);
+
+	/* the line, and each pipeline with its commands at once */
+	SUNIT_ASSERT("line and pipelines", parse_allocations("a | b | c ; d", s) == 3);
+	SUNIT_ASSERT("reused", parse_allocations("a | b | c ; d", s) == 0);
+	SUNIT_ASSERT("reused by other words", parse_allocations("x y z | w | v ; u", s) == 0);
+
+	/* past the pipelines a sequence holds, they are queued in an allocated array */
+	SUNIT_ASSERT("more pipelines", parse_allocations("a ; b ; c ; d ; e", s) == 4 + 1);
+	SUNIT_ASSERT("reused more", parse_allocations("a ; b ; c ; d ; e", s) == 0);
+	SUNIT_ASSERT("nothing to parse", parse_allocations("  ", s) == 0);
+	msh_sequence_free(s);
+
+	return SUNIT_SUCCESS;
+}
+
+/* appends `word` to `buf` `n` times */
+static char *
+repeat(char *buf, const char *word, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) strcat(buf, word);
+
+	return buf;
+}
+
+#define REUSE_ROUNDS 10
+
+/* once a line has been parsed, parsing it again takes no allocations, however long it is */
+sunit_ret_t
+test_reuse(void)
+{
+	struct msh_sequence *s = msh_sequence_alloc();
+	static char stages[2048] = "cat f", pipelines[2048] = "mkdir out", mixed[2048] = "a";
+	const char *small[] = { "ls", "a | b", "a ; b | c ; d &", "x y z 1> f", "cat f | sort | uniq -c | sort -rn | head" };
+	const char *lines[4];
+	size_t i, r, allocs;
+
+	SUNIT_ASSERT("allocate", s != NULL);
+	lines[0] = repeat(stages, " | grep x", 100);
+	lines[1] = repeat(pipelines, " ; cp f out", 100);
+	/* pipelines of 20, 40, and 30 commands, more than any but the last class holds */
+	repeat(mixed, " | b", 19);
+	repeat(strcat(mixed, " ; c"), " | d", 39);
+	lines[2] = repeat(strcat(mixed, " ; e"), " | f", 29);
+	lines[3] = "ls -la";
+
+	for (i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+		SUNIT_ASSERT("warm up", parse_allocations(lines[i], s) != (size_t)-1);
+		for (r = 0, allocs = 0; r < REUSE_ROUNDS; r++) allocs += parse_allocations(lines[i], s);
+		SUNIT_ASSERT("flat", allocs == 0);
+	}
+
+	/* the short lines a shell mostly parses share the pool */
+	for (i = 0; i < sizeof(small) / sizeof(small[0]); i++) parse_allocations(small[i], s);
+	for (r = 0, allocs = 0; r < REUSE_ROUNDS; r++) {
+		for (i = 0; i < sizeof(small) / sizeof(small[0]); i++) allocs += parse_allocations(small[i], s);
+	}
+	SUNIT_ASSERT("flat for short lines", allocs == 0);
+	msh_sequence_free(s);
+
+	return SUNIT_SUCCESS;
+}
+
+#define GROW_ARGS 1000
+#define GROW_CMDS 100
+
+/* there are no limits on the args of a command, or the commands of a pipeline */
+sunit_ret_t
+test_grow(void)
+{
+	struct msh_sequence *s = msh_sequence_alloc();
+	struct msh_pipeline *p;
+	struct msh_command *c;
+	static char args[GROW_ARGS * 8] = "rm", cmds[GROW_CMDS * 8] = "c0";
+	char word[16];
+	size_t i, r, allocs;
+	char **a;
+
+	SUNIT_ASSERT("allocate", s != NULL);
+	for (i = 1; i < GROW_ARGS; i++) {
+		snprintf(word, sizeof(word), " f%zu", i);
+		strcat(args, word);
+	}
+	for (i = 1; i < GROW_CMDS; i++) {
+		snprintf(word, sizeof(word), " | c%zu", i);
+		strcat(cmds, word);
+	}
+
+	SUNIT_ASSERT("parse args", msh_sequence_parse(args, s) == 0);
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("one command", p != NULL && msh_pipeline_command(p, 1) == NULL);
+	a = msh_command_args(msh_pipeline_command(p, 0));
+	for (i = 1; i < GROW_ARGS; i++) {
+		snprintf(word, sizeof(word), "f%zu", i);
+		SUNIT_ASSERT("arg", a[i] != NULL && strcmp(a[i], word) == 0);
+	}
+	SUNIT_ASSERT("terminated", a[GROW_ARGS] == NULL);
+	msh_pipeline_free(p);
+	msh_sequence_reset(s);
+
+	SUNIT_ASSERT("parse commands", msh_sequence_parse(cmds, s) == 0);
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("pipeline", p != NULL);
+	for (i = 0; i < GROW_CMDS; i++) {
+		snprintf(word, sizeof(word), "c%zu", i);
+		c = msh_pipeline_command(p, i);
+		SUNIT_ASSERT("command", c != NULL && args_are(c, word) && msh_command_final(c) == (i == GROW_CMDS - 1));
+	}
+	SUNIT_ASSERT("no more", msh_pipeline_command(p, GROW_CMDS) == NULL);
+	msh_pipeline_free(p);
+	msh_sequence_reset(s);
+
+	/* the args keep the room they grew to, so the next lines do not grow them again */
+	for (r = 0, allocs = 0; r < REUSE_ROUNDS; r++) allocs += parse_allocations(args, s);
+	SUNIT_ASSERT("flat", allocs == 0);
+
+	/* and a shorter command in the same pipeline is terminated where it ends */
+	SUNIT_ASSERT("parse shorter", msh_sequence_parse("rm a b", s) == 0);
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("shorter", p != NULL && args_are(msh_pipeline_command(p, 0), "rm a b"));
+	msh_pipeline_free(p);
+	msh_sequence_free(s);
+
+	return SUNIT_SUCCESS;
+}
+
+#define QUEUE_OPS 20000
+
+/* lines parsed before the pipelines of earlier ones are all dequeued queue up
+ * after them, so that the queue wraps around and grows while it wraps */
+sunit_ret_t
+test_queue(void)
+{
+	struct msh_sequence *s = msh_sequence_alloc();
+	struct msh_pipeline *p;
+	char line[256], *prog;
+	int op, i, n, next = 0, expect = 0;
+
+	SUNIT_ASSERT("allocate", s != NULL);
+	srand(1);
+	for (op = 0; op < QUEUE_OPS; op++) {
+		n = rand() % 12;
+		if (rand() % 2) {
+			line[0] = '\0';
+			for (i = 0; i < n + 1; i++) sprintf(line + strlen(line), "c%d x ;", next++);
+			SUNIT_ASSERT("parse", msh_sequence_parse(line, s) == 0);
+			continue;
+		}
+		for (i = 0; i < n && (p = msh_sequence_pipeline(s)) != NULL; i++) {
+			prog = msh_command_program(msh_pipeline_command(p, 0));
+			SUNIT_ASSERT("in order", atoi(prog + 1) == expect);
+			expect++;
+			msh_pipeline_free(p);
+		}
+	}
+
+	/* a line with an error still queues the pipelines before it */
+	sprintf(line, "c%d ; c%d | ; c%d", next, next + 1, next + 2);
+	SUNIT_ASSERT("error", msh_sequence_parse(line, s) == MSH_ERR_PIPE_MISSING_CMD);
+	next++;
+	while ((p = msh_sequence_pipeline(s)) != NULL) {
+		prog = msh_command_program(msh_pipeline_command(p, 0));
+		SUNIT_ASSERT("in order", atoi(prog + 1) == expect);
+		expect++;
+		msh_pipeline_free(p);
+	}
+	SUNIT_ASSERT("all", expect == next);
+	msh_sequence_free(s);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_parse(void)
+{
+	struct msh_sequence *s = msh_sequence_alloc();
+	struct msh_pipeline *p;
+	struct msh_command *c;
+	char *out, *err;
+	char line[] = "cat  f.txt|grep -v x\t1>>out.txt;sleep 10 &; ls 2>err";
+
+	SUNIT_ASSERT("allocate", s != NULL);
+	SUNIT_ASSERT("parse", msh_sequence_parse(line, s) == 0);
+
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("pipeline", p != NULL && !msh_pipeline_background(p));
+	SUNIT_ASSERT("text", strcmp(msh_pipeline_input(p), "cat  f.txt|grep -v x\t1>>out.txt") == 0);
+	c = msh_pipeline_command(p, 0);
+	SUNIT_ASSERT("first", c != NULL && args_are(c, "cat f.txt") && !msh_command_final(c));
+	c = msh_pipeline_command(p, 1);
+	SUNIT_ASSERT("second", c != NULL && args_are(c, "grep -v x 1>> out.txt") && msh_command_final(c));
+	SUNIT_ASSERT("program", strcmp(msh_command_program(c), "grep") == 0);
+	msh_command_file_outputs(c, &out, &err);
+	SUNIT_ASSERT("redirected", out != NULL && strcmp(out, "out.txt") == 0 && err == NULL);
+	SUNIT_ASSERT("no third", msh_pipeline_command(p, 2) == NULL);
+	msh_pipeline_free(p);
+
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("background", p != NULL && msh_pipeline_background(p));
+	SUNIT_ASSERT("background text", strcmp(msh_pipeline_input(p), "sleep 10 &") == 0);
+	msh_pipeline_free(p);
+
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("last", p != NULL && args_are(msh_pipeline_command(p, 0), "ls 2> err"));
+	msh_pipeline_free(p);
+	SUNIT_ASSERT("empty", msh_sequence_pipeline(s) == NULL);
+	msh_sequence_reset(s);
+
+	/* `>` is short for `1>` and ends the word before it, and the line is
+	 * copied, so changing it after does not change the args */
+	strcpy(line, "echo a>b");
+	SUNIT_ASSERT("parse redirect", msh_sequence_parse(line, s) == 0);
+	line[0] = 'X';
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("short redirect", p != NULL && args_are(msh_pipeline_command(p, 0), "echo a 1> b"));
+	SUNIT_ASSERT("copied text", strcmp(msh_pipeline_input(p), "echo a>b") == 0);
+	msh_pipeline_free(p);
+
+	/* a trailing `;` and blanks add no pipeline */
+	strcpy(line, "ls ;  ");
+	SUNIT_ASSERT("trailing", msh_sequence_parse(line, s) == 0);
+	SUNIT_ASSERT("one", (p = msh_sequence_pipeline(s)) != NULL && msh_sequence_pipeline(s) == NULL);
+	msh_pipeline_free(p);
+	msh_sequence_free(s);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_errors(void)
+{
+	struct {
+		const char *line;
+		msh_err_t err;
+	} cases[] = {
+		{ "a ; ; b",    MSH_ERR_SEQ_MISSING_CMD },
+		{ "; a",        MSH_ERR_SEQ_MISSING_CMD },
+		{ "a |",        MSH_ERR_PIPE_MISSING_CMD },
+		{ "| a",        MSH_ERR_PIPE_MISSING_CMD },
+		{ "a | | b",    MSH_ERR_PIPE_MISSING_CMD },
+		{ "a | ; b",    MSH_ERR_PIPE_MISSING_CMD },
+		{ "a | &",      MSH_ERR_PIPE_MISSING_CMD },
+		{ "a 1>",       MSH_ERR_NO_REDIR_FILE },
+		{ "a 2> ; b",   MSH_ERR_NO_REDIR_FILE },
+		{ "& ls",       MSH_ERR_MISUSED_BACKGROUND },
+		{ "echo x & &", MSH_ERR_MISUSED_BACKGROUND },
+		{ "a & b",      MSH_ERR_MISUSED_BACKGROUND },
+		{ "",           MSH_ERR_PIPE_MISSING_CMD },
+	};
+	struct msh_sequence *s = msh_sequence_alloc();
+	struct msh_pipeline *p;
+	char line[64];
+	size_t i;
+
+	SUNIT_ASSERT("allocate", s != NULL);
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		strcpy(line, cases[i].line);
+		SUNIT_ASSERT("error", msh_sequence_parse(line, s) == cases[i].err);
+		msh_sequence_reset(s);
+	}
+
+	/* the pipelines before the error are kept, the one with it is not */
+	strcpy(line, "a ; b | ; c");
+	SUNIT_ASSERT("late error", msh_sequence_parse(line, s) == MSH_ERR_PIPE_MISSING_CMD);
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("kept", p != NULL && args_are(msh_pipeline_command(p, 0), "a"));
+	SUNIT_ASSERT("not kept", msh_sequence_pipeline(s) == NULL);
+	msh_pipeline_free(p);
+
+	/* and the sequence is good for the next line */
+	strcpy(line, "ok");
+	SUNIT_ASSERT("after the error", msh_sequence_parse(line, s) == 0);
+	p = msh_sequence_pipeline(s);
+	SUNIT_ASSERT("parsed", p != NULL && args_are(msh_pipeline_command(p, 0), "ok"));
+	msh_pipeline_free(p);
+	msh_sequence_free(s);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("msh_sequence_parse allocations", test_allocations),
+		SUNIT_TEST("msh_sequence_reset reuses memory", test_reuse),
+		SUNIT_TEST("msh_sequence_parse grows", test_grow),
+		SUNIT_TEST("msh_sequence_pipeline queues in order", test_queue),
+		SUNIT_TEST("msh_sequence_parse", test_parse),
+		SUNIT_TEST("msh_sequence_parse errors", test_errors),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Parsing lines", tests);
+
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sunit.h>
+#include <ngram.h>
+
+sunit_ret_t
+test_search(void)
+{
+	struct ngram *ng = ngram_allocate();
+	const char *out[4];
+
+	SUNIT_ASSERT("allocate", ng != NULL);
+	SUNIT_ASSERT("add", ngram_add(ng, "git checkout main", 1) == 0 && ngram_add(ng, "make check", 3) == 0);
+	SUNIT_ASSERT("add", ngram_add(ng, "ls -la", 2) == 0);
+
+	/* the highest ranked first */
+	SUNIT_ASSERT("search", ngram_search(ng, "check", 4, out) == 2);
+	SUNIT_ASSERT("ranked", strcmp(out[0], "make check") == 0 && strcmp(out[1], "git checkout main") == 0);
+	SUNIT_ASSERT("short", ngram_search(ng, "-", 4, out) == 1 && strcmp(out[0], "ls -la") == 0);
+	SUNIT_ASSERT("k", ngram_search(ng, "", 2, out) == 2 && strcmp(out[1], "ls -la") == 0);
+	SUNIT_ASSERT("trigrams but no match", ngram_search(ng, "checkmake", 4, out) == 0);
+	SUNIT_ASSERT("miss", ngram_search(ng, "zzz", 4, out) == 0);
+
+	/* adding again only sets the rank */
+	SUNIT_ASSERT("re-add", ngram_add(ng, "git checkout main", 5) == 0);
+	SUNIT_ASSERT("re-ranked", ngram_search(ng, "check", 4, out) == 2 && strcmp(out[0], "git checkout main") == 0);
+
+	/* equal ranks go to the one added last */
+	SUNIT_ASSERT("add tie", ngram_add(ng, "make checkup", 3) == 0);
+	SUNIT_ASSERT("tie", ngram_search(ng, "make", 4, out) == 2 && strcmp(out[0], "make checkup") == 0);
+	ngram_free(ng);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_remove(void)
+{
+	struct ngram *ng = ngram_allocate();
+	const char *out[4];
+
+	SUNIT_ASSERT("allocate", ng != NULL);
+	SUNIT_ASSERT("add", ngram_add(ng, "ssh user@host", 1) == 0 && ngram_add(ng, "ssh -v user@host", 1) == 0);
+	SUNIT_ASSERT("remove", ngram_remove(ng, "ssh user@host") == 0);
+	SUNIT_ASSERT("removed", ngram_search(ng, "user@", 4, out) == 1 && strcmp(out[0], "ssh -v user@host") == 0);
+	SUNIT_ASSERT("removed short", ngram_search(ng, "ss", 4, out) == 1);
+	SUNIT_ASSERT("removed twice", ngram_remove(ng, "ssh user@host") == -1);
+	SUNIT_ASSERT("never added", ngram_remove(ng, "ssh") == -1);
+	SUNIT_ASSERT("re-add", ngram_add(ng, "ssh user@host", 2) == 0);
+	SUNIT_ASSERT("re-added", ngram_search(ng, "user@", 4, out) == 2 && strcmp(out[0], "ssh user@host") == 0);
+	ngram_free(ng);
+
+	return SUNIT_SUCCESS;
+}
+
+#define NSTRS 500
+#define NOPS  20000
+
+/* adds and removes at random, so that the index is rebuilt many times, and
+ * checks the searches against a scan of every string */
+sunit_ret_t
+test_remove_random(void)
+{
+	struct ngram *ng = ngram_allocate();
+	static char strs[NSTRS][32];
+	int live[NSTRS] = { 0 }, ranks[NSTRS] = { 0 };
+	const char *out[8];
+	char substr[8];
+	int i, j, op;
+
+	SUNIT_ASSERT("allocate", ng != NULL);
+	srand(5);
+	for (i = 0; i < NSTRS; i++) snprintf(strs[i], sizeof(strs[i]), "run %d --seed %x", i, rand() % 4096);
+
+	for (op = 0; op < NOPS; op++) {
+		i = rand() % NSTRS;
+		if (rand() % 2) {
+			ranks[i] = rand() % 1000;
+			SUNIT_ASSERT("add", ngram_add(ng, strs[i], ranks[i]) == 0);
+			live[i] = 1;
+		} else {
+			SUNIT_ASSERT("remove", ngram_remove(ng, strs[i]) == (live[i] ? 0 : -1));
+			live[i] = 0;
+		}
+
+		/* the best match has the highest rank of the strings holding the substring */
+		int len = 1 + rand() % 4, start = rand() % (strlen(strs[i]) - len + 1), best = -1;
+		size_t n, expect = 0;
+
+		memcpy(substr, strs[i] + start, len);
+		substr[len] = '\0';
+		for (j = 0; j < NSTRS; j++) {
+			if (live[j] && strstr(strs[j], substr) != NULL) {
+				expect++;
+				if (ranks[j] > best) best = ranks[j];
+			}
+		}
+		n = ngram_search(ng, substr, 8, out);
+		SUNIT_ASSERT("count", n == (expect < 8 ? expect : 8));
+		for (j = 0; n > 0 && j < NSTRS; j++) {
+			if (strcmp(strs[j], out[0]) == 0) break;
+		}
+		SUNIT_ASSERT("best", n == 0 || (j < NSTRS && live[j] && ranks[j] == best));
+	}
+	ngram_free(ng);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("ngram search", test_search),
+		SUNIT_TEST("ngram remove", test_remove),
+		SUNIT_TEST("ngram add and remove at random", test_remove_random),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Searching by substring", tests);
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sunit.h>
+#include <ptrie.h>
+
+#define BUDGET (16 << 10)
+
+sunit_ret_t
+test_budget(void)
+{
+	struct ptrie *pt = ptrie_allocate();
+	struct ptrie_stats stats;
+	char str[64];
+	int i;
+
+	SUNIT_ASSERT("allocate", pt != NULL);
+	ptrie_set_budget(pt, BUDGET);
+
+	/* a frequent string, then many more rare ones than fit */
+	for (i = 0; i < 20; i++) SUNIT_ASSERT("add frequent", ptrie_add(pt, "make -j8") == 0);
+	for (i = 0; i < 2000; i++) {
+		snprintf(str, sizeof(str), "./run --case %d --seed %d", i, i * 7);
+		SUNIT_ASSERT("add", ptrie_add(pt, str) == 0);
+		ptrie_stats(pt, &stats);
+		SUNIT_ASSERT("within budget", stats.bytes <= BUDGET);
+		/* the string just added is never the one evicted */
+		SUNIT_ASSERT("newest kept", ptrie_count(pt, str) == 1);
+	}
+	ptrie_stats(pt, &stats);
+	SUNIT_ASSERT("evicted", stats.keys < 2000 && stats.budget == BUDGET);
+
+	/* the old, rare strings went first */
+	SUNIT_ASSERT("oldest rare evicted", ptrie_count(pt, "./run --case 0 --seed 0") == 0);
+	SUNIT_ASSERT("recent kept", ptrie_count(pt, "./run --case 1998 --seed 13986") == 1);
+
+	/* completions only offer what is left */
+	SUNIT_ASSERT("completion", strcmp(ptrie_lookup(pt, "./run --case 1999"), "./run --case 1999 --seed 13993") == 0);
+	SUNIT_ASSERT("evicted completion", ptrie_lookup(pt, "./run --case 0 ") == NULL);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_budget_frequent(void)
+{
+	struct ptrie *pt = ptrie_allocate();
+	struct ptrie_stats stats;
+	char str[64];
+	int i;
+
+	SUNIT_ASSERT("allocate", pt != NULL);
+	ptrie_set_budget(pt, BUDGET);
+
+	/* a budget too small for anything keeps only the string added last */
+	for (i = 0; i < 5; i++) SUNIT_ASSERT("add frequent", ptrie_add(pt, "git status") == 0);
+	SUNIT_ASSERT("add rare", ptrie_add(pt, "git stash pop") == 0);
+	for (i = 0; i < 20; i++) {
+		snprintf(str, sizeof(str), "echo %d", i);
+		SUNIT_ASSERT("add", ptrie_add(pt, str) == 0);
+	}
+	ptrie_set_budget(pt, 1);
+	SUNIT_ASSERT("only the newest", ptrie_count(pt, "echo 19") == 1 && ptrie_count(pt, "git status") == 0);
+
+	/* lowering the budget evicts right away, the frequent string last */
+	ptrie_set_budget(pt, 0);
+	SUNIT_ASSERT("remove", ptrie_remove(pt, "echo 19") == 0);
+	for (i = 0; i < 5; i++) SUNIT_ASSERT("add frequent", ptrie_add(pt, "git status") == 0);
+	SUNIT_ASSERT("add rare", ptrie_add(pt, "git stash pop") == 0);
+	SUNIT_ASSERT("add newest", ptrie_add(pt, "ls") == 0);
+	ptrie_set_budget(pt, BUDGET);
+	SUNIT_ASSERT("under a loose budget", ptrie_count(pt, "git stash pop") == 1);
+	/* enough room for two of the three strings */
+	ptrie_stats(pt, &stats);
+	ptrie_set_budget(pt, stats.bytes - 1);
+	SUNIT_ASSERT("rare evicted first", ptrie_count(pt, "git stash pop") == 0);
+	SUNIT_ASSERT("frequent kept", ptrie_count(pt, "git status") == 5 && ptrie_count(pt, "ls") == 1);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("ptrie stays within its budget", test_budget),
+		SUNIT_TEST("ptrie evicts rare strings first", test_budget_frequent),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Bounding the memory of ptries", tests);
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sunit.h>
+#include <ptrie.h>
+
+#define NKEYS 3000
+#define K     8
+
+/* short strings over a few characters, so that they share many prefixes and repeat */
+static void
+random_key(char *buf, size_t size)
+{
+	static const char chars[] = "abc -/";
+	size_t i, len = 1 + rand() % (size - 1);
+
+	for (i = 0; i < len; i++) buf[i] = chars[rand() % (sizeof(chars) - 1)];
+	buf[len] = '\0';
+}
+
+/* whether `a` and `b` complete `prefix` the same way */
+static int
+same_completions(struct ptrie *a, struct ptrie *b, const char *prefix)
+{
+	const char *outa[K], *outb[K], *la = ptrie_lookup(a, prefix), *lb = ptrie_lookup(b, prefix);
+	size_t i, n = ptrie_topk(a, prefix, K, outa);
+
+	if ((la == NULL) != (lb == NULL) || (la != NULL && strcmp(la, lb) != 0)) return 0;
+	if (ptrie_topk(b, prefix, K, outb) != n) return 0;
+	for (i = 0; i < n; i++) {
+		if (strcmp(outa[i], outb[i]) != 0) return 0;
+	}
+
+	return 1;
+}
+
+sunit_ret_t
+test_bulk_random(void)
+{
+	static char keys[NKEYS][12];
+	const char *ptrs[NKEYS + 2];
+	struct ptrie *added = ptrie_allocate(), *bulk;
+	struct ptrie_stats sa, sb;
+	char prefix[12];
+	size_t i, j;
+
+	SUNIT_ASSERT("allocate", added != NULL);
+	srand(12);
+	for (i = 0; i < NKEYS; i++) {
+		random_key(keys[i], sizeof(keys[i]));
+		ptrs[i] = keys[i];
+		SUNIT_ASSERT("add", ptrie_add(added, keys[i]) == 0);
+	}
+	/* what ptrie_add rejects is left out */
+	ptrs[NKEYS] = "";
+	ptrs[NKEYS + 1] = "caf\xc3\xa9";
+	SUNIT_ASSERT("rejected", ptrie_add(added, ptrs[NKEYS]) != 0 && ptrie_add(added, ptrs[NKEYS + 1]) != 0);
+
+	bulk = ptrie_build_bulk(ptrs, NKEYS + 2);
+	SUNIT_ASSERT("build", bulk != NULL);
+	ptrie_stats(added, &sa);
+	ptrie_stats(bulk, &sb);
+	SUNIT_ASSERT("keys", sa.keys == sb.keys);
+
+	for (i = 0; i < NKEYS; i++) {
+		SUNIT_ASSERT("count", ptrie_count(added, keys[i]) == ptrie_count(bulk, keys[i]));
+		for (j = 0; keys[i][j] != '\0'; j++) {
+			memcpy(prefix, keys[i], j);
+			prefix[j] = '\0';
+			SUNIT_ASSERT("completions", same_completions(added, bulk, prefix));
+		}
+	}
+	SUNIT_ASSERT("miss", same_completions(added, bulk, "x"));
+	ptrie_free(added);
+	ptrie_free(bulk);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_bulk_empty(void)
+{
+	const char *keys[] = { "", "\x80" };
+	struct ptrie *pt = ptrie_build_bulk(keys, 2);
+	const char *out[K];
+
+	SUNIT_ASSERT("build", pt != NULL);
+	SUNIT_ASSERT("nothing", ptrie_lookup(pt, "") == NULL && ptrie_topk(pt, "", K, out) == 0);
+	SUNIT_ASSERT("add after", ptrie_add(pt, "ls") == 0 && strcmp(ptrie_lookup(pt, "l"), "ls") == 0);
+	ptrie_free(pt);
+
+	pt = ptrie_build_bulk(NULL, 0);
+	SUNIT_ASSERT("build none", pt != NULL && ptrie_lookup(pt, "") == NULL);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("ptrie bulk build matches adding one by one", test_bulk_random),
+		SUNIT_TEST("ptrie bulk build of nothing", test_bulk_empty),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Building ptries in bulk", tests);
+
+	return 0;
+}
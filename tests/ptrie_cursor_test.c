@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sunit.h>
+#include <ptrie.h>
+
+#define NOPS    50000
+#define LINELEN 300
+
+/* whether the cursor's hint for `line` is the one a fresh lookup finds */
+static int
+same_hint(struct ptrie_cursor *c, struct ptrie *pt, const char *line)
+{
+	const char *hint = ptrie_cursor_lookup(c, pt, line), *fresh = ptrie_lookup(pt, line);
+
+	if (hint == NULL || fresh == NULL) return hint == fresh;
+	return strcmp(hint, fresh) == 0;
+}
+
+static void
+random_word(char *buf, size_t size)
+{
+	static const char chars[] = "abc -";
+	size_t i, len = 1 + rand() % (size - 1);
+
+	for (i = 0; i < len; i++) buf[i] = chars[rand() % (sizeof(chars) - 1)];
+	buf[len] = '\0';
+}
+
+/*
+ * Types and deletes at the end of a line at random, sometimes replacing
+ * it or looking it up in another ptrie, while strings are added and
+ * removed, which the cursor has to notice.
+ */
+sunit_ret_t
+test_cursor_random(void)
+{
+	static const char typed[] = "abcd -";
+	struct ptrie *pt = ptrie_allocate(), *other = ptrie_allocate(), *cur;
+	struct ptrie_cursor *c = ptrie_cursor_allocate();
+	char line[LINELEN + 1] = "", word[16];
+	size_t len = 0;
+	int op, i;
+
+	SUNIT_ASSERT("allocate", pt != NULL && other != NULL && c != NULL);
+	srand(17);
+	for (i = 0; i < 500; i++) {
+		random_word(word, sizeof(word));
+		SUNIT_ASSERT("add", ptrie_add(pt, word) == 0 && ptrie_add(other, word + 1) == (word[1] == '\0' ? -1 : 0));
+	}
+
+	for (op = 0; op < NOPS; op++) {
+		int r = rand() % 100;
+
+		cur = pt;
+		if (r < 45 && len < LINELEN) {
+			line[len++] = typed[rand() % (sizeof(typed) - 1)];
+		} else if (r < 80) {
+			if (len > 0) len--;
+		} else if (r < 85) {
+			len = rand() % 8;
+			for (i = 0; i < (int)len; i++) line[i] = typed[rand() % (sizeof(typed) - 1)];
+		} else if (r < 90) {
+			/* the line is run, as the shell does */
+			line[len] = '\0';
+			if (len > 0) SUNIT_ASSERT("add line", ptrie_add(pt, line) == 0);
+		} else if (r < 95) {
+			random_word(word, sizeof(word));
+			if (rand() % 2) ptrie_add(pt, word);
+			else ptrie_remove(pt, word);
+		} else {
+			cur = other;
+		}
+		line[len] = '\0';
+		SUNIT_ASSERT("hint", same_hint(c, cur, line));
+	}
+	ptrie_cursor_free(c);
+	ptrie_free(pt);
+	ptrie_free(other);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_cursor_frozen(void)
+{
+	struct ptrie *pt = ptrie_allocate();
+	struct ptrie_cursor *c = ptrie_cursor_allocate();
+
+	SUNIT_ASSERT("allocate", pt != NULL && c != NULL);
+	SUNIT_ASSERT("add", ptrie_add(pt, "git status") == 0 && ptrie_add(pt, "git stash") == 0);
+	SUNIT_ASSERT("empty", same_hint(c, pt, "") && same_hint(c, pt, "g"));
+	SUNIT_ASSERT("freeze", ptrie_freeze(pt) == 0);
+	SUNIT_ASSERT("frozen", same_hint(c, pt, "gi") && same_hint(c, pt, "git st"));
+	SUNIT_ASSERT("frozen miss", ptrie_cursor_lookup(c, pt, "git sx") == NULL && same_hint(c, pt, "git s"));
+
+	/* thawing changes the ptrie under the cursor */
+	SUNIT_ASSERT("thaw", ptrie_add(pt, "git stash") == 0);
+	SUNIT_ASSERT("thawed", strcmp(ptrie_cursor_lookup(c, pt, "git s"), "git stash") == 0);
+	SUNIT_ASSERT("no cursor", same_hint(NULL, pt, "git"));
+	ptrie_cursor_free(c);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("ptrie cursor hints while typing", test_cursor_random),
+		SUNIT_TEST("ptrie cursor on a frozen ptrie", test_cursor_frozen),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Looking up with cursors", tests);
+
+	return 0;
+}
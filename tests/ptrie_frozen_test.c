@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <sunit.h>
+#include <ptrie.h>
+
+/*
+ * Where ptrie_save puts things in the file, to corrupt them: a 24 byte
+ * header, then the frozen block's 24 byte header (size, nnodes, fchars,
+ * keys), then 24 byte nodes (label, len, key, best, child, nchildren),
+ * and the key records (rank, count, len, str) in the keys area.
+ */
+#define FILE_HEADER   24
+#define BLOCK_NNODES  (FILE_HEADER + 8)
+#define BLOCK_KEYS    (FILE_HEADER + 16)
+#define NODES         (FILE_HEADER + 24)
+#define NODE_SIZE     24
+#define NODE_CHILD    16
+#define NODE_NCHILD   20
+#define KEY_LEN       12
+#define KEY_STR       16
+
+static const char *words[] = { "git", "git status", "git stash", "grep", "gcc -O2", "ls", "ls -la", "make", NULL };
+
+static char file[64], bad[64];
+
+static struct ptrie *
+build(void)
+{
+	struct ptrie *pt = ptrie_allocate();
+	int i;
+
+	if (pt == NULL) return NULL;
+	for (i = 0; words[i] != NULL; i++) {
+		if (ptrie_add(pt, words[i]) != 0) {
+			ptrie_free(pt);
+			return NULL;
+		}
+	}
+	/* so that "git status" is the best completion of "git" */
+	ptrie_add(pt, "git status");
+	ptrie_add(pt, "git status");
+
+	return pt;
+}
+
+/* the contents of `file`, and its size in `size` */
+static char *
+slurp(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "r");
+	char *buf;
+
+	if (f == NULL) return NULL;
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = malloc(*size);
+	if (buf != NULL && fread(buf, 1, *size, f) != *size) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+
+	return buf;
+}
+
+static int
+spew(const char *path, const char *buf, size_t size)
+{
+	FILE *f = fopen(path, "w");
+	int ret;
+
+	if (f == NULL) return -1;
+	ret = fwrite(buf, 1, size, f) == size ? 0 : -1;
+	fclose(f);
+
+	return ret;
+}
+
+static uint32_t
+get32(const char *buf, size_t off)
+{
+	uint32_t v;
+
+	memcpy(&v, buf + off, sizeof(v));
+	return v;
+}
+
+static void
+put32(char *buf, size_t off, uint32_t v)
+{
+	memcpy(buf + off, &v, sizeof(v));
+}
+
+/* whether a copy of the saved file, `size` long and changed by `corrupt`, loads */
+static int
+loads(size_t size, void (*corrupt)(char *buf, size_t size))
+{
+	size_t orig;
+	char *buf = slurp(file, &orig);
+	struct ptrie *pt;
+
+	if (buf == NULL || size > orig) {
+		free(buf);
+		return -1;
+	}
+	if (corrupt != NULL) corrupt(buf, size);
+	if (spew(bad, buf, size) != 0) {
+		free(buf);
+		return -1;
+	}
+	free(buf);
+
+	pt = ptrie_load(bad, 42);
+	if (pt == NULL) return 0;
+	/* walking every key must stay inside the mapping */
+	ptrie_free(pt);
+	return 1;
+}
+
+sunit_ret_t
+test_freeze(void)
+{
+	struct ptrie *pt = build();
+	const char *out[4];
+	char *str;
+
+	SUNIT_ASSERT("build", pt != NULL);
+	SUNIT_ASSERT("freeze", ptrie_freeze(pt) == 0);
+	SUNIT_ASSERT("lookup", strcmp(ptrie_lookup(pt, "gi"), "git status") == 0);
+	SUNIT_ASSERT("lookup miss", ptrie_lookup(pt, "x") == NULL);
+	SUNIT_ASSERT("count", ptrie_count(pt, "git status") == 3 && ptrie_count(pt, "git") == 1);
+	SUNIT_ASSERT("topk", ptrie_topk(pt, "ls", 4, out) == 2);
+	str = ptrie_autocomplete(pt, "ma");
+	SUNIT_ASSERT("autocomplete", str != NULL && strcmp(str, "make") == 0);
+	free(str);
+
+	/* adding thaws it, and everything is still there */
+	SUNIT_ASSERT("thaw", ptrie_add(pt, "ls -la") == 0);
+	SUNIT_ASSERT("thawed count", ptrie_count(pt, "ls -la") == 2 && ptrie_count(pt, "grep") == 1);
+	SUNIT_ASSERT("thawed lookup", strcmp(ptrie_lookup(pt, "l"), "ls -la") == 0);
+	SUNIT_ASSERT("thawed remove", ptrie_remove(pt, "git") == 0 && ptrie_count(pt, "git") == 0);
+	SUNIT_ASSERT("refreeze", ptrie_freeze(pt) == 0);
+	SUNIT_ASSERT("refrozen lookup", strcmp(ptrie_lookup(pt, "git st"), "git status") == 0);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_save_load(void)
+{
+	struct ptrie *pt = build();
+	struct ptrie_stats stats;
+
+	SUNIT_ASSERT("build", pt != NULL);
+	SUNIT_ASSERT("save", ptrie_save(pt, file, 42) == 0);
+	ptrie_free(pt);
+
+	SUNIT_ASSERT("wrong stamp", ptrie_load(file, 43) == NULL);
+	pt = ptrie_load(file, 42);
+	SUNIT_ASSERT("load", pt != NULL);
+	SUNIT_ASSERT("loaded lookup", strcmp(ptrie_lookup(pt, "g"), "git status") == 0);
+	ptrie_stats(pt, &stats);
+	SUNIT_ASSERT("loaded keys", stats.keys == 8);
+
+	/* a loaded ptrie thaws out of its mapping like a frozen one */
+	SUNIT_ASSERT("loaded add", ptrie_add(pt, "make test") == 0);
+	SUNIT_ASSERT("loaded thawed", ptrie_count(pt, "make test") == 1 && ptrie_count(pt, "gcc -O2") == 1);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+/* the last key record's length runs past the end of the block */
+static void
+long_key(char *buf, size_t size)
+{
+	(void)size;
+	put32(buf, FILE_HEADER + get32(buf, BLOCK_KEYS) + KEY_LEN, 1 << 20);
+}
+
+/* the first key record is one shorter, so its string is not NUL-terminated */
+static void
+unterminated_key(char *buf, size_t size)
+{
+	size_t len = FILE_HEADER + get32(buf, BLOCK_KEYS) + KEY_LEN;
+
+	(void)size;
+	put32(buf, len, get32(buf, len) - 1);
+}
+
+/* the size of the key record at `off`, rounded up like ptrie_save does */
+static size_t
+key_record(const char *buf, size_t off)
+{
+	return (KEY_STR + get32(buf, off + KEY_LEN) + 1 + 7) & ~(size_t)7;
+}
+
+/* two neighbouring key records of the same size trade places, so the keys are out of order */
+static void
+swapped_keys(char *buf, size_t size)
+{
+	size_t off = FILE_HEADER + get32(buf, BLOCK_KEYS), rec, next;
+	char tmp[64];
+
+	while ((next = off + (rec = key_record(buf, off))) < size) {
+		if (key_record(buf, next) == rec && rec <= sizeof(tmp)) {
+			memcpy(tmp, buf + off, rec);
+			memcpy(buf + off, buf + next, rec);
+			memcpy(buf + next, tmp, rec);
+			return;
+		}
+		off = next;
+	}
+}
+
+/* the last key, so that the keys stay in order, gets a character past ASCII */
+static void
+non_ascii_key(char *buf, size_t size)
+{
+	size_t off = FILE_HEADER + get32(buf, BLOCK_KEYS);
+
+	while (off + key_record(buf, off) < size) off += key_record(buf, off);
+	buf[off + KEY_STR + get32(buf, off + KEY_LEN) - 1] = (char)0xe9;
+}
+
+/* the root is its own child */
+static void
+cyclic_root(char *buf, size_t size)
+{
+	(void)size;
+	put32(buf, NODES + NODE_CHILD, 0);
+}
+
+/* a node's children go back up to the root's */
+static void
+cyclic_child(char *buf, size_t size)
+{
+	uint32_t i, nnodes = get32(buf, BLOCK_NNODES);
+
+	(void)size;
+	for (i = 1; i < nnodes; i++) {
+		if (get32(buf, NODES + i * NODE_SIZE + NODE_NCHILD) > 0) {
+			put32(buf, NODES + i * NODE_SIZE + NODE_CHILD, 1);
+			return;
+		}
+	}
+}
+
+sunit_ret_t
+test_load_corrupt(void)
+{
+	struct ptrie *pt = build();
+	size_t size;
+	char *buf;
+
+	SUNIT_ASSERT("build", pt != NULL);
+	SUNIT_ASSERT("save", ptrie_save(pt, file, 42) == 0);
+	ptrie_free(pt);
+	buf = slurp(file, &size);
+	SUNIT_ASSERT("read", buf != NULL);
+	free(buf);
+
+	SUNIT_ASSERT("intact", loads(size, NULL) == 1);
+	SUNIT_ASSERT("truncated", loads(size - 1, NULL) == 0);
+	SUNIT_ASSERT("truncated header", loads(FILE_HEADER + 8, NULL) == 0);
+	SUNIT_ASSERT("key past the end", loads(size, long_key) == 0);
+	SUNIT_ASSERT("key without a NUL", loads(size, unterminated_key) == 0);
+	SUNIT_ASSERT("root is its own child", loads(size, cyclic_root) == 0);
+	SUNIT_ASSERT("child before its parent", loads(size, cyclic_child) == 0);
+	SUNIT_ASSERT("keys out of order", loads(size, swapped_keys) == 0);
+	SUNIT_ASSERT("key past ASCII", loads(size, non_ascii_key) == 0);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("ptrie freeze and thaw", test_freeze),
+		SUNIT_TEST("ptrie save and load", test_save_load),
+		SUNIT_TEST("ptrie load of a corrupt file", test_load_corrupt),
+		SUNIT_TEST_TERM
+	};
+
+	snprintf(file, sizeof(file), "/tmp/ptrie_frozen_test.%d", (int)getpid());
+	snprintf(bad, sizeof(bad), "/tmp/ptrie_frozen_test.%d.bad", (int)getpid());
+	sunit_execute("Frozen, saved, and loaded ptries", tests);
+	unlink(file);
+	unlink(bad);
+
+	return 0;
+}
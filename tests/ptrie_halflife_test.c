@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <sunit.h>
+#include <ptrie.h>
+
+#define K 8
+
+/* a half-life this short makes a sleep of a few dozen ms worth many half-lives */
+#define HALFLIFE 0.005
+#define LATER    50000
+
+sunit_ret_t
+test_recent_beats_frequent(void)
+{
+	struct ptrie *pt = ptrie_allocate();
+	const char *out[K];
+	int i;
+
+	SUNIT_ASSERT("allocate", pt != NULL);
+	SUNIT_ASSERT("halflife", ptrie_set_halflife(pt, HALFLIFE) == 0);
+	for (i = 0; i < 4; i++) SUNIT_ASSERT("add old", ptrie_add(pt, "make") == 0);
+	SUNIT_ASSERT("add old", ptrie_add(pt, "mkdir x") == 0 && ptrie_add(pt, "mkdir x") == 0);
+	SUNIT_ASSERT("frequent first", strcmp(ptrie_lookup(pt, "m"), "make") == 0);
+
+	/* four adds long ago count for less than one now */
+	usleep(LATER);
+	SUNIT_ASSERT("add new", ptrie_add(pt, "mv a b") == 0);
+	SUNIT_ASSERT("recent first", strcmp(ptrie_lookup(pt, "m"), "mv a b") == 0);
+	SUNIT_ASSERT("topk", ptrie_topk(pt, "m", K, out) == 3 && strcmp(out[0], "mv a b") == 0);
+	SUNIT_ASSERT("older by frequency", strcmp(out[1], "make") == 0 && strcmp(out[2], "mkdir x") == 0);
+	SUNIT_ASSERT("rank", ptrie_rank(pt, "mv a b") > ptrie_rank(pt, "make"));
+	SUNIT_ASSERT("count unchanged", ptrie_count(pt, "make") == 4);
+
+	/* adding the old one again makes it the most recent, and it keeps its past */
+	usleep(LATER);
+	SUNIT_ASSERT("add again", ptrie_add(pt, "mkdir x") == 0);
+	SUNIT_ASSERT("again first", ptrie_topk(pt, "m", K, out) == 3 && strcmp(out[0], "mkdir x") == 0);
+	SUNIT_ASSERT("then the recent", strcmp(out[1], "mv a b") == 0 && strcmp(out[2], "make") == 0);
+
+	/* removing takes back one of its adds, the share of its rank it is worth on average */
+	SUNIT_ASSERT("remove", ptrie_remove(pt, "mkdir x") == 0 && ptrie_remove(pt, "mkdir x") == 0);
+	SUNIT_ASSERT("removed", ptrie_count(pt, "mkdir x") == 1 && strcmp(ptrie_lookup(pt, "mk"), "mkdir x") == 0);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_halflife_set(void)
+{
+	struct ptrie *pt = ptrie_allocate();
+
+	SUNIT_ASSERT("allocate", pt != NULL);
+	SUNIT_ASSERT("negative", ptrie_set_halflife(pt, -1) == -1);
+	SUNIT_ASSERT("add", ptrie_add(pt, "ls") == 0);
+	SUNIT_ASSERT("not empty", ptrie_set_halflife(pt, HALFLIFE) == -1);
+	SUNIT_ASSERT("by count", ptrie_rank(pt, "ls") == 1 && ptrie_rank(pt, "cd") == -INFINITY);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+#define NKEYS 2000
+
+/*
+ * With an infinite half-life every add weighs the same, so frecency ranks
+ * like plain frequency, down to equal counts giving equal ranks that are
+ * then ordered by string the same way.
+ */
+sunit_ret_t
+test_halflife_ties(void)
+{
+	struct ptrie *plain = ptrie_allocate(), *frecent = ptrie_allocate();
+	static char keys[NKEYS][8];
+	const char *outp[K], *outf[K];
+	char prefix[8];
+	size_t i, j, n;
+
+	SUNIT_ASSERT("allocate", plain != NULL && frecent != NULL);
+	SUNIT_ASSERT("halflife", ptrie_set_halflife(frecent, INFINITY) == 0);
+	srand(14);
+	for (i = 0; i < NKEYS; i++) {
+		/* few and short strings, so that many are added equally often */
+		snprintf(keys[i], sizeof(keys[i]), "%c%c%c", 'a' + rand() % 3, 'a' + rand() % 4, 'a' + rand() % 4);
+		SUNIT_ASSERT("add", ptrie_add(plain, keys[i]) == 0 && ptrie_add(frecent, keys[i]) == 0);
+	}
+	for (i = 1; i < NKEYS; i++) {
+		unsigned int a = ptrie_count(frecent, keys[0]), b = ptrie_count(frecent, keys[i]);
+		double ra = ptrie_rank(frecent, keys[0]), rb = ptrie_rank(frecent, keys[i]);
+
+		SUNIT_ASSERT("ranks like counts", (a == b && ra == rb) || (a < b && ra < rb) || (a > b && ra > rb));
+	}
+
+	for (i = 0; i < NKEYS; i++) {
+		for (j = 0; j < 3; j++) {
+			memcpy(prefix, keys[i], j);
+			prefix[j] = '\0';
+			n = ptrie_topk(plain, prefix, K, outp);
+			SUNIT_ASSERT("topk count", ptrie_topk(frecent, prefix, K, outf) == n);
+			while (n-- > 0) SUNIT_ASSERT("topk order", strcmp(outp[n], outf[n]) == 0);
+			SUNIT_ASSERT("lookup", strcmp(ptrie_lookup(plain, prefix), ptrie_lookup(frecent, prefix)) == 0);
+		}
+	}
+	ptrie_free(plain);
+	ptrie_free(frecent);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("ptrie frecency favors recent strings", test_recent_beats_frequent),
+		SUNIT_TEST("ptrie half-life only on an empty ptrie", test_halflife_set),
+		SUNIT_TEST("ptrie frecency ties", test_halflife_ties),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Ranking ptries by frecency", tests);
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sunit.h>
+#include <ptrie.h>
+
+sunit_ret_t
+test_remove(void)
+{
+	struct ptrie *pt = ptrie_allocate();
+
+	SUNIT_ASSERT("allocate", pt != NULL);
+	SUNIT_ASSERT("add", ptrie_add(pt, "cat") == 0 && ptrie_add(pt, "cat") == 0);
+	SUNIT_ASSERT("add", ptrie_add(pt, "cargo") == 0 && ptrie_add(pt, "car") == 0);
+	SUNIT_ASSERT("best", strcmp(ptrie_lookup(pt, "ca"), "cat") == 0);
+
+	/* each remove takes one count off, and the key goes at zero */
+	SUNIT_ASSERT("remove", ptrie_remove(pt, "cat") == 0 && ptrie_count(pt, "cat") == 1);
+	SUNIT_ASSERT("remove", ptrie_remove(pt, "cat") == 0 && ptrie_count(pt, "cat") == 0);
+	SUNIT_ASSERT("removed too often", ptrie_remove(pt, "cat") == -1);
+	SUNIT_ASSERT("never added", ptrie_remove(pt, "ca") == -1 && ptrie_remove(pt, "dog") == -1);
+	SUNIT_ASSERT("gone", ptrie_lookup(pt, "cat") == NULL);
+
+	/* the prefixes complete to what is left, and the rest is intact */
+	SUNIT_ASSERT("best after", ptrie_lookup(pt, "ca") != NULL && strcmp(ptrie_lookup(pt, "ca"), "cat") != 0);
+	SUNIT_ASSERT("prefix key", ptrie_count(pt, "car") == 1 && ptrie_count(pt, "cargo") == 1);
+	SUNIT_ASSERT("remove prefix key", ptrie_remove(pt, "car") == 0);
+	SUNIT_ASSERT("longer key left", strcmp(ptrie_lookup(pt, "c"), "cargo") == 0);
+	SUNIT_ASSERT("remove last", ptrie_remove(pt, "cargo") == 0);
+	SUNIT_ASSERT("empty", ptrie_lookup(pt, "c") == NULL);
+
+	/* and it can be filled again */
+	SUNIT_ASSERT("re-add", ptrie_add(pt, "cargo") == 0 && strcmp(ptrie_lookup(pt, ""), "cargo") == 0);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+#define NSTRS 64
+#define NOPS  20000
+
+/* adds and removes random strings, checking the counts and completions against an array */
+sunit_ret_t
+test_remove_random(void)
+{
+	struct ptrie *pt = ptrie_allocate();
+	char strs[NSTRS][8];
+	unsigned int counts[NSTRS] = { 0 };
+	int i, j, op;
+
+	SUNIT_ASSERT("allocate", pt != NULL);
+	srand(7);
+	for (i = 0; i < NSTRS; i++) {
+		int len = 1 + rand() % 6;
+
+		for (j = 0; j < len; j++) strs[i][j] = "abc"[rand() % 3];
+		strs[i][len] = '\0';
+		for (j = 0; j < i; j++) {
+			if (strcmp(strs[i], strs[j]) == 0) break;
+		}
+		/* no duplicates */
+		if (j < i) i--;
+	}
+
+	for (op = 0; op < NOPS; op++) {
+		i = rand() % NSTRS;
+		if (rand() % 2) {
+			SUNIT_ASSERT("add", ptrie_add(pt, strs[i]) == 0);
+			counts[i]++;
+		} else {
+			SUNIT_ASSERT("remove", ptrie_remove(pt, strs[i]) == (counts[i] > 0 ? 0 : -1));
+			if (counts[i] > 0) counts[i]--;
+		}
+		SUNIT_ASSERT("count", ptrie_count(pt, strs[i]) == counts[i]);
+
+		/* the completion of a prefix of the string is one of the most added with it */
+		char prefix[8];
+		const char *best;
+		unsigned int max = 0, best_count = 0;
+
+		strncpy(prefix, strs[i], sizeof(prefix));
+		prefix[rand() % (strlen(prefix) + 1)] = '\0';
+		for (j = 0; j < NSTRS; j++) {
+			if (strncmp(strs[j], prefix, strlen(prefix)) == 0 && counts[j] > max) max = counts[j];
+		}
+		best = ptrie_lookup(pt, prefix);
+		for (j = 0; best != NULL && j < NSTRS; j++) {
+			if (strcmp(strs[j], best) == 0) best_count = counts[j];
+		}
+		SUNIT_ASSERT("completion", max == 0 ? best == NULL : best != NULL && best_count == max);
+	}
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("ptrie remove", test_remove),
+		SUNIT_TEST("ptrie add and remove at random", test_remove_random),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Removing from ptries", tests);
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <sunit.h>
+#include <ptrie.h>
+
+/*
+ * One writer keeps adding and removing pairs of strings and publishing,
+ * while readers check every snapshot they see:
+ *
+ * - `a<i>` and `b<i>` are always added and removed together, so they
+ *   have the same count in every snapshot.
+ * - `version` is added once per publish, so its count never goes down
+ *   from one snapshot to the next.
+ * - Completions of `a` and `b` start with them.
+ *
+ * The writer stops after a fixed number of publishes, which bounds the
+ * run time, also under valgrind.
+ */
+#define READERS   4
+#define PAIRS     500
+#define BATCH     16
+#define PUBLISHES 300
+#define TOPK      8
+
+static struct ptrie_shared *shared;
+static _Atomic int done;
+static _Atomic int failures;
+static _Atomic size_t reads;
+
+static void *
+writer(void *arg)
+{
+	struct ptrie *pt = ptrie_allocate();
+	unsigned int seed = 1;
+	char a[32], b[32];
+	int i, p, pair;
+
+	(void)arg;
+	if (pt == NULL) atomic_fetch_add(&failures, 1);
+	for (p = 0; pt != NULL && p < PUBLISHES; p++) {
+		for (i = 0; i < BATCH; i++) {
+			pair = rand_r(&seed) % PAIRS;
+			snprintf(a, sizeof(a), "a%d", pair);
+			snprintf(b, sizeof(b), "b%d", pair);
+			if (rand_r(&seed) % 3 == 0 && ptrie_count(pt, a) > 0) {
+				ptrie_remove(pt, a);
+				ptrie_remove(pt, b);
+			} else {
+				ptrie_add(pt, a);
+				ptrie_add(pt, b);
+			}
+		}
+		ptrie_add(pt, "version");
+		if (ptrie_shared_publish(shared, pt) != 0) atomic_fetch_add(&failures, 1);
+	}
+	atomic_store(&done, 1);
+	ptrie_free(pt);
+
+	return NULL;
+}
+
+/* whether `snap` holds together, and is no older than `version` */
+static int
+consistent(struct ptrie *snap, unsigned int *seed, unsigned int *version)
+{
+	const char *out[TOPK], *best = ptrie_lookup(snap, "a");
+	unsigned int seen = ptrie_count(snap, "version");
+	int pair = rand_r(seed) % PAIRS;
+	char a[32], b[32];
+	size_t i, n;
+
+	snprintf(a, sizeof(a), "a%d", pair);
+	snprintf(b, sizeof(b), "b%d", pair);
+	if (ptrie_count(snap, a) != ptrie_count(snap, b)) return 0;
+	if (seen < *version) return 0;
+	*version = seen;
+	if (best != NULL && best[0] != 'a') return 0;
+	n = ptrie_topk(snap, "b", TOPK, out);
+	for (i = 0; i < n; i++) {
+		if (out[i][0] != 'b') return 0;
+	}
+
+	return 1;
+}
+
+static void *
+reader(void *arg)
+{
+	int slot = ptrie_shared_register(shared);
+	unsigned int seed = slot + 2, version = 0;
+	struct ptrie *snap;
+
+	(void)arg;
+	if (slot < 0) {
+		atomic_fetch_add(&failures, 1);
+		return NULL;
+	}
+	while (!atomic_load(&done)) {
+		snap = ptrie_shared_enter(shared, slot);
+		if (snap != NULL) {
+			if (!consistent(snap, &seed, &version)) atomic_fetch_add(&failures, 1);
+			atomic_fetch_add(&reads, 1);
+		}
+		ptrie_shared_exit(shared, slot);
+	}
+	ptrie_shared_unregister(shared, slot);
+
+	return NULL;
+}
+
+sunit_ret_t
+test_readers_and_writer(void)
+{
+	pthread_t readers[READERS], writing;
+	int i;
+
+	shared = ptrie_shared_allocate();
+	SUNIT_ASSERT("allocate", shared != NULL);
+	for (i = 0; i < READERS; i++) SUNIT_ASSERT("reader", pthread_create(&readers[i], NULL, reader, NULL) == 0);
+	SUNIT_ASSERT("writer", pthread_create(&writing, NULL, writer, NULL) == 0);
+	pthread_join(writing, NULL);
+	for (i = 0; i < READERS; i++) pthread_join(readers[i], NULL);
+	ptrie_shared_free(shared);
+
+	SUNIT_ASSERT("every snapshot consistent", atomic_load(&failures) == 0);
+	SUNIT_ASSERT("snapshots read", atomic_load(&reads) > 0);
+
+	return SUNIT_SUCCESS;
+}
+
+sunit_ret_t
+test_publish(void)
+{
+	struct ptrie_shared *sh = ptrie_shared_allocate();
+	struct ptrie *pt = ptrie_allocate(), *snap;
+	int slot;
+
+	SUNIT_ASSERT("allocate", sh != NULL && pt != NULL);
+	slot = ptrie_shared_register(sh);
+	SUNIT_ASSERT("register", slot >= 0);
+	SUNIT_ASSERT("nothing yet", ptrie_shared_enter(sh, slot) == NULL);
+	ptrie_shared_exit(sh, slot);
+
+	/* readers see what was published, not what the writer changed since */
+	SUNIT_ASSERT("add", ptrie_add(pt, "ls") == 0);
+	SUNIT_ASSERT("publish", ptrie_shared_publish(sh, pt) == 0);
+	SUNIT_ASSERT("add after", ptrie_add(pt, "ls -la") == 0 && ptrie_add(pt, "ls -la") == 0);
+	snap = ptrie_shared_enter(sh, slot);
+	SUNIT_ASSERT("published", snap != NULL && strcmp(ptrie_lookup(snap, "l"), "ls") == 0);
+	SUNIT_ASSERT("not after", ptrie_count(snap, "ls -la") == 0);
+	ptrie_shared_exit(sh, slot);
+	SUNIT_ASSERT("publish again", ptrie_shared_publish(sh, pt) == 0);
+	snap = ptrie_shared_enter(sh, slot);
+	SUNIT_ASSERT("latest", snap != NULL && strcmp(ptrie_lookup(snap, "l"), "ls -la") == 0);
+	ptrie_shared_exit(sh, slot);
+
+	ptrie_shared_unregister(sh, slot);
+	ptrie_shared_free(sh);
+	ptrie_free(pt);
+
+	return SUNIT_SUCCESS;
+}
+
+int
+main(void)
+{
+	struct sunit_test tests[] = {
+		SUNIT_TEST("ptrie shared publish", test_publish),
+		SUNIT_TEST("ptrie shared readers see consistent snapshots", test_readers_and_writer),
+		SUNIT_TEST_TERM
+	};
+
+	sunit_execute("Sharing ptries between threads", tests);
+
+	return 0;
+}